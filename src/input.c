@@ -279,6 +279,25 @@ vec2_t input_mouse_pos(void) {
 	return vec2(mouse_x, mouse_y);
 }
 
+void input_actions_get(input_actions_t *actions) {
+	actions->pressed = 0;
+	actions->released = 0;
+	for (int i = 0; i < INPUT_ACTION_MAX; i++) {
+		actions->state[i] = actions_state[i];
+		actions->pressed |= (uint32_t)actions_pressed[i] << i;
+		actions->released |= (uint32_t)actions_released[i] << i;
+	}
+}
+
+void input_actions_set(input_actions_t *actions) {
+	for (int i = 0; i < INPUT_ACTION_MAX; i++) {
+		actions_state[i] = actions->state[i];
+		actions_pressed[i] = (actions->pressed >> i) & 1;
+		actions_released[i] = (actions->released >> i) & 1;
+	}
+	clear(expected_button);
+}
+
 
 button_t input_name_to_button(const char *name) {
 	for (int32_t i = 0; i < INPUT_BUTTON_MAX; i++) {
@@ -188,4 +188,15 @@ const char *input_button_to_name(button_t button);
 #define INPUT_ACTION_NONE 255
 #define INPUT_BUTTON_NONE 0
 
+// The complete action state as seen by the game for one frame; used to
+// record and replay input. Pressed and released are bit masks by action.
+typedef struct {
+	float state[INPUT_ACTION_MAX];
+	uint32_t pressed;
+	uint32_t released;
+} input_actions_t;
+
+void input_actions_get(input_actions_t *actions);
+void input_actions_set(input_actions_t *actions);
+
 #endif
@@ -0,0 +1,337 @@
+#include "jobs.h"
+#include "utils.h"
+#include "mem.h"
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+	#include <pthread.h>
+	#include <unistd.h>
+	#define JOBS_PTHREADS
+#elif defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#define JOBS_WIN32
+#endif
+
+
+// The few thread primitives we need, on top of pthreads or Win32. Win32
+// slim rw locks and condition variables can be initialized statically just
+// like their pthread counterparts.
+
+#if defined(JOBS_PTHREADS)
+	#define JOBS_THREADS
+
+	typedef pthread_t jobs_thread_t;
+	typedef pthread_mutex_t jobs_mutex_t;
+	typedef pthread_cond_t jobs_cond_t;
+	#define JOBS_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+	#define JOBS_COND_INIT PTHREAD_COND_INITIALIZER
+
+	#define JOBS_THREAD_FUNC(NAME) void *NAME(void *arg)
+	#define JOBS_THREAD_RETURN return NULL
+
+	#define jobs_mutex_lock(M) pthread_mutex_lock(M)
+	#define jobs_mutex_unlock(M) pthread_mutex_unlock(M)
+	#define jobs_cond_wait(C, M) pthread_cond_wait(C, M)
+	#define jobs_cond_broadcast(C) pthread_cond_broadcast(C)
+
+	static bool jobs_thread_create(jobs_thread_t *thread, void *(*func)(void *arg), void *arg) {
+		return pthread_create(thread, NULL, func, arg) == 0;
+	}
+
+	static void jobs_thread_join(jobs_thread_t thread) {
+		pthread_join(thread, NULL);
+	}
+
+	static long jobs_num_cores(void) {
+		return sysconf(_SC_NPROCESSORS_ONLN);
+	}
+#elif defined(JOBS_WIN32)
+	#define JOBS_THREADS
+
+	typedef HANDLE jobs_thread_t;
+	typedef SRWLOCK jobs_mutex_t;
+	typedef CONDITION_VARIABLE jobs_cond_t;
+	#define JOBS_MUTEX_INIT SRWLOCK_INIT
+	#define JOBS_COND_INIT CONDITION_VARIABLE_INIT
+
+	#define JOBS_THREAD_FUNC(NAME) DWORD WINAPI NAME(LPVOID arg)
+	#define JOBS_THREAD_RETURN return 0
+
+	#define jobs_mutex_lock(M) AcquireSRWLockExclusive(M)
+	#define jobs_mutex_unlock(M) ReleaseSRWLockExclusive(M)
+	#define jobs_cond_wait(C, M) SleepConditionVariableSRW(C, M, INFINITE, 0)
+	#define jobs_cond_broadcast(C) WakeAllConditionVariable(C)
+
+	static bool jobs_thread_create(jobs_thread_t *thread, LPTHREAD_START_ROUTINE func, void *arg) {
+		*thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+		return *thread != NULL;
+	}
+
+	static void jobs_thread_join(jobs_thread_t thread) {
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+
+	static long jobs_num_cores(void) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwNumberOfProcessors;
+	}
+#endif
+
+
+#if defined(JOBS_THREADS)
+
+static jobs_thread_t workers[JOBS_WORKERS_MAX];
+static uint32_t workers_len = 0;
+
+// All job state is guarded by the mutex. Jobs are coarse (one image, one
+// track tile), so the lock is not contended enough to matter.
+static jobs_mutex_t lock = JOBS_MUTEX_INIT;
+static jobs_cond_t job_added = JOBS_COND_INIT;
+static jobs_cond_t job_done = JOBS_COND_INIT;
+static job_func_t job_func;
+static void *job_data;
+static uint32_t job_count;
+static uint32_t job_next;
+static uint32_t job_finished;
+static uint32_t job_generation;
+static bool quit;
+
+// Only one caller can hand out a job to the workers at a time, so that the
+// main thread and the background task can both use jobs_parallel_for()
+static jobs_mutex_t submit_lock = JOBS_MUTEX_INIT;
+
+typedef struct {
+	jobs_thread_t thread;
+	bool started;
+	bool finished;
+	bool wake_pending;
+	void (*func)(void *data);
+	void *data;
+} background_task_t;
+
+static background_task_t background_tasks[NUM_JOBS_BACKGROUND];
+
+static jobs_mutex_t shared_lock = JOBS_MUTEX_INIT;
+
+// Sleeping background tasks wait for their wake_pending flag. This has its
+// own lock, since the audio callback wakes the music decoder.
+static jobs_mutex_t wake_lock = JOBS_MUTEX_INIT;
+static jobs_cond_t wake_added = JOBS_COND_INIT;
+
+// Runs indices of the current job until none are left; called with the lock
+// held and returns with it held.
+static void jobs_work(void) {
+	while (job_next < job_count) {
+		job_func_t func = job_func;
+		void *data = job_data;
+		uint32_t index = job_next++;
+
+		jobs_mutex_unlock(&lock);
+		func(data, index);
+		jobs_mutex_lock(&lock);
+
+		job_finished++;
+		if (job_finished == job_count) {
+			jobs_cond_broadcast(&job_done);
+		}
+	}
+}
+
+static JOBS_THREAD_FUNC(jobs_worker) {
+	(void)arg;
+	uint32_t seen_generation = 0;
+
+	jobs_mutex_lock(&lock);
+	while (true) {
+		while (!quit && seen_generation == job_generation) {
+			jobs_cond_wait(&job_added, &lock);
+		}
+		if (quit) {
+			break;
+		}
+		seen_generation = job_generation;
+		jobs_work();
+	}
+	jobs_mutex_unlock(&lock);
+	mem_temp_release_thread();
+	JOBS_THREAD_RETURN;
+}
+
+void jobs_init(void) {
+	uint32_t wanted = clamp(jobs_num_cores() - 1, 0, JOBS_WORKERS_MAX);
+
+	for (uint32_t i = 0; i < wanted; i++) {
+		if (!jobs_thread_create(&workers[workers_len], jobs_worker, NULL)) {
+			break;
+		}
+		workers_len++;
+	}
+	printf("jobs: %d worker threads\n", workers_len);
+}
+
+void jobs_cleanup(void) {
+	for (int i = 0; i < NUM_JOBS_BACKGROUND; i++) {
+		jobs_background_wait(i);
+	}
+
+	jobs_mutex_lock(&lock);
+	quit = true;
+	jobs_cond_broadcast(&job_added);
+	jobs_mutex_unlock(&lock);
+
+	for (uint32_t i = 0; i < workers_len; i++) {
+		jobs_thread_join(workers[i]);
+	}
+	workers_len = 0;
+}
+
+uint32_t jobs_num_threads(void) {
+	return workers_len + 1;
+}
+
+void jobs_parallel_for(job_func_t func, void *data, uint32_t count) {
+	if (workers_len == 0 || count < 2) {
+		for (uint32_t i = 0; i < count; i++) {
+			func(data, i);
+		}
+		return;
+	}
+
+	jobs_mutex_lock(&submit_lock);
+	jobs_mutex_lock(&lock);
+	job_func = func;
+	job_data = data;
+	job_count = count;
+	job_next = 0;
+	job_finished = 0;
+	job_generation++;
+	jobs_cond_broadcast(&job_added);
+
+	jobs_work();
+	while (job_finished < job_count) {
+		jobs_cond_wait(&job_done, &lock);
+	}
+	jobs_mutex_unlock(&lock);
+	jobs_mutex_unlock(&submit_lock);
+}
+
+static JOBS_THREAD_FUNC(jobs_background) {
+	background_task_t *task = arg;
+	task->func(task->data);
+	mem_temp_release_thread();
+
+	jobs_mutex_lock(&lock);
+	task->finished = true;
+	jobs_mutex_unlock(&lock);
+	JOBS_THREAD_RETURN;
+}
+
+bool jobs_background_start(jobs_background_t slot, void (*func)(void *data), void *data) {
+	if (jobs_background_busy(slot)) {
+		return false;
+	}
+	jobs_background_wait(slot);
+
+	background_task_t *task = &background_tasks[slot];
+	task->func = func;
+	task->data = data;
+	task->finished = false;
+	task->wake_pending = false;
+	if (!jobs_thread_create(&task->thread, jobs_background, task)) {
+		return false;
+	}
+	task->started = true;
+	return true;
+}
+
+bool jobs_background_busy(jobs_background_t slot) {
+	background_task_t *task = &background_tasks[slot];
+	jobs_mutex_lock(&lock);
+	bool busy = task->started && !task->finished;
+	jobs_mutex_unlock(&lock);
+	return busy;
+}
+
+void jobs_background_wait(jobs_background_t slot) {
+	background_task_t *task = &background_tasks[slot];
+	if (task->started) {
+		jobs_thread_join(task->thread);
+		task->started = false;
+	}
+}
+
+void jobs_background_sleep(jobs_background_t slot) {
+	background_task_t *task = &background_tasks[slot];
+	jobs_mutex_lock(&wake_lock);
+	while (!task->wake_pending) {
+		jobs_cond_wait(&wake_added, &wake_lock);
+	}
+	task->wake_pending = false;
+	jobs_mutex_unlock(&wake_lock);
+}
+
+void jobs_background_wake(jobs_background_t slot) {
+	background_task_t *task = &background_tasks[slot];
+	jobs_mutex_lock(&wake_lock);
+	task->wake_pending = true;
+	jobs_cond_broadcast(&wake_added);
+	jobs_mutex_unlock(&wake_lock);
+}
+
+void jobs_lock(void) {
+	jobs_mutex_lock(&shared_lock);
+}
+
+void jobs_unlock(void) {
+	jobs_mutex_unlock(&shared_lock);
+}
+
+#else
+
+// No threads on this platform; run everything on the calling thread
+
+void jobs_init(void) {}
+void jobs_cleanup(void) {}
+
+uint32_t jobs_num_threads(void) {
+	return 1;
+}
+
+void jobs_parallel_for(job_func_t func, void *data, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		func(data, i);
+	}
+}
+
+bool jobs_background_start(jobs_background_t slot, void (*func)(void *data), void *data) {
+	(void)slot; (void)func; (void)data;
+	return false;
+}
+
+bool jobs_background_busy(jobs_background_t slot) {
+	(void)slot;
+	return false;
+}
+
+void jobs_background_wait(jobs_background_t slot) {
+	(void)slot;
+}
+
+void jobs_background_sleep(jobs_background_t slot) {
+	(void)slot;
+}
+
+void jobs_background_wake(jobs_background_t slot) {
+	(void)slot;
+}
+void jobs_lock(void) {}
+void jobs_unlock(void) {}
+
+#endif
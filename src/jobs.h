@@ -0,0 +1,44 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "types.h"
+
+#define JOBS_WORKERS_MAX 15
+
+typedef void (*job_func_t)(void *data, uint32_t index);
+
+void jobs_init(void);
+void jobs_cleanup(void);
+uint32_t jobs_num_threads(void);
+
+// Calls func(data, i) for every i in [0, count) and returns when all calls
+// have finished. Calls are spread over the worker threads and the calling
+// thread, so func must not touch the hunk or the renderer.
+void jobs_parallel_for(job_func_t func, void *data, uint32_t count);
+
+// Background task slots; tasks in different slots run concurrently
+typedef enum {
+	JOBS_BACKGROUND_PREFETCH,
+	JOBS_BACKGROUND_SAVE,
+	JOBS_BACKGROUND_MUSIC,
+	NUM_JOBS_BACKGROUND
+} jobs_background_t;
+
+// Runs func(data) on a background thread. Only one task per slot can run at
+// a time; jobs_background_start() returns false if the slot is still busy or
+// if the platform has no threads.
+bool jobs_background_start(jobs_background_t slot, void (*func)(void *data), void *data);
+bool jobs_background_busy(jobs_background_t slot);
+void jobs_background_wait(jobs_background_t slot);
+
+// For long running tasks: jobs_background_sleep() blocks the task until
+// jobs_background_wake() is called for its slot. A wake that arrives while
+// the task is still busy is not lost; the next sleep returns right away.
+void jobs_background_sleep(jobs_background_t slot);
+void jobs_background_wake(jobs_background_t slot);
+
+// A global lock for state that is shared with the background task
+void jobs_lock(void);
+void jobs_unlock(void);
+
+#endif
@@ -1,15 +1,115 @@
 #include <stdlib.h>
 #include <string.h>
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#define MEM_VIRTUAL
+#endif
 
 #include "mem.h"
 #include "utils.h"
 
-static uint8_t hunk[MEM_HUNK_BYTES];
+static uint8_t *hunk = NULL;
+static uint32_t hunk_size = 0;
 static uint32_t bump_len = 0;
 static uint32_t temp_len = 0;
 
-static uint32_t temp_objects[MEM_TEMP_OBJECTS_MAX] = {};
-static uint32_t temp_objects_len;
+// Highest bump_len and temp_len since the last mem_reset(); everything
+// between these and the current levels can be given back to the OS
+static uint32_t bump_high = 0;
+static uint32_t temp_high = 0;
+
+typedef struct {
+	uint32_t size;
+	uint32_t flags;
+} temp_header_t;
+
+#define TEMP_FLAG_FREED (1 << 0)
+#define TEMP_FLAG_HEAP (1 << 1)
+
+typedef struct {
+	uint8_t *base;
+	uint32_t size;
+	uint32_t len;
+	uint32_t objects_len;
+} temp_arena_t;
+
+static temp_arena_t hunk_arena;
+static thread_local temp_arena_t thread_arena;
+static thread_local temp_arena_t *arena = NULL;
+
+// Memory accounting. The bump allocations are a stack of spans with the same
+// tag, so that mem_reset() knows how many bytes it takes from each tag.
+typedef struct {
+	uint32_t offset;
+	mem_tag_t tag;
+} tag_span_t;
+
+static const char *tag_names[] = {
+	[MEM_TAG_NONE] = "none",
+	[MEM_TAG_UI] = "ui",
+	[MEM_TAG_TEXTURES] = "textures",
+	[MEM_TAG_TRACK] = "track",
+	[MEM_TAG_SCENE] = "scene",
+	[MEM_TAG_OBJECTS] = "objects",
+	[MEM_TAG_SFX] = "sfx",
+	[MEM_TAG_PARTICLES] = "particles",
+	[MEM_TAG_WEAPONS] = "weapons",
+};
+
+static mem_tag_t tag_current = MEM_TAG_NONE;
+static tag_span_t tag_spans[MEM_TAG_SPANS_MAX];
+static uint32_t tag_spans_len = 0;
+static uint32_t tag_bytes[NUM_MEM_TAGS];
+static uint32_t tag_bytes_peak[NUM_MEM_TAGS];
+static uint32_t tag_accounted_len = 0;
+
+// Highest level of bump + temp bytes since the last mem_dump() and overall
+static uint32_t hunk_high = 0;
+static uint32_t hunk_peak = 0;
+
+
+
+// The hunk is reserved as one range of virtual memory at startup. The OS only
+// commits the pages that are touched, so a large hunk doesn't cost anything
+// until a scene actually uses it. Pages above the bump and temp levels are
+// decommitted again in mem_reset(). Platforms without mmap() allocate the
+// whole hunk up front.
+
+void mem_init(uint32_t size) {
+	error_if(hunk, "Hunk already initialized");
+
+	#if defined(MEM_VIRTUAL)
+		uint32_t page_size = sysconf(_SC_PAGESIZE);
+		size = ((size + page_size - 1) / page_size) * page_size;
+		void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		error_if(p == MAP_FAILED, "Failed to reserve %d bytes for the hunk", size);
+		hunk = p;
+	#else
+		hunk = malloc(size);
+		error_if(!hunk, "Failed to allocate %d bytes for the hunk", size);
+	#endif
+
+	hunk_size = size;
+	hunk_arena = (temp_arena_t){.base = hunk, .size = size};
+	arena = &hunk_arena;
+	printf("mem: hunk of %d MB\n", size / (1024 * 1024));
+}
+
+static void mem_decommit(uint32_t start, uint32_t end) {
+	#if defined(MEM_VIRTUAL)
+		// Only whole pages, so that we never touch live bytes next to the range
+		uint32_t page_size = sysconf(_SC_PAGESIZE);
+		start = ((start + page_size - 1) / page_size) * page_size;
+		end = (end / page_size) * page_size;
+		if (end > start && end - start >= MEM_DECOMMIT_MIN_BYTES) {
+			madvise(hunk + start, end - start, MADV_DONTNEED);
+		}
+	#else
+		(void)start; (void)end;
+	#endif
+}
+
 
 
 // Bump allocator - returns bytes from the front of the hunk
@@ -34,20 +134,66 @@ void *mem_bump(uint32_t size) {
 	return mem_bump_unaligned(size);
 }
 
+static void *mem_bump_bytes(uint32_t size) {
+	error_if(bump_len + temp_len + size >= hunk_size, "Failed to allocate %d bytes in hunk mem", size);
+	uint8_t *p = &hunk[bump_len];
+	bump_len += size;
+	bump_high = max(bump_high, bump_len);
+	hunk_high = max(hunk_high, bump_len + temp_len);
+
+	// Account these bytes, including any alignment padding before them
+	if (tag_spans_len == 0 || tag_spans[tag_spans_len - 1].tag != tag_current) {
+		error_if(tag_spans_len >= MEM_TAG_SPANS_MAX, "MEM_TAG_SPANS_MAX reached");
+		tag_spans[tag_spans_len++] = (tag_span_t){tag_accounted_len, tag_current};
+	}
+	tag_bytes[tag_current] += bump_len - tag_accounted_len;
+	tag_bytes_peak[tag_current] = max(tag_bytes_peak[tag_current], tag_bytes[tag_current]);
+	tag_accounted_len = bump_len;
+	return p;
+}
+
 // The only time this ever gets called is for loading primitives and objects.
 // Ideally we would never call it at all, given the risk of bus errors.
 
 void *mem_bump_unaligned(uint32_t size) {
-	error_if(bump_len + temp_len + size >= MEM_HUNK_BYTES, "Failed to allocate %d bytes in hunk mem", size);
-	uint8_t *p = &hunk[bump_len];
-	bump_len += size;
+	void *p = mem_bump_bytes(size);
 	memset(p, 0, size);
 	return p;
 }
+
+// Like mem_bump, but the returned bytes are not cleared. Only use this for
+// large buffers that are completely overwritten right away.
+
+void *mem_bump_uninit(uint32_t size) {
+	bump_len = round_up_to_word(bump_len);
+	size = round_up_to_word(size);
+	return mem_bump_bytes(size);
+}
+
 void mem_reset(void *p) {
 	uint32_t offset = (uint8_t *)p - (uint8_t *)hunk;
-	error_if(offset > bump_len || offset > MEM_HUNK_BYTES, "Invalid mem reset");
+	error_if(offset > bump_len || offset > hunk_size, "Invalid mem reset");
 	bump_len = offset;
+
+	// Take the released bytes from the tags of all spans above the offset
+	uint32_t end = tag_accounted_len;
+	while (tag_spans_len > 0 && end > offset) {
+		tag_span_t *span = &tag_spans[tag_spans_len - 1];
+		uint32_t start = max(span->offset, offset);
+		tag_bytes[span->tag] -= end - start;
+		if (span->offset < offset) {
+			break;
+		}
+		end = span->offset;
+		tag_spans_len--;
+	}
+	tag_accounted_len = min(tag_accounted_len, offset);
+
+	// Give the pages that are no longer used back to the OS
+	mem_decommit(bump_len, min(bump_high, hunk_size - temp_high));
+	mem_decommit(max(hunk_size - temp_high, bump_len), hunk_size - temp_len);
+	bump_high = bump_len;
+	temp_high = temp_len;
 }
 
 
@@ -55,41 +201,123 @@ void mem_reset(void *p) {
 // Temp allocator - returns bytes from the back of the hunk
 
 // Temporary allocated bytes are not allowed to persist for multiple frames. You
-// need to explicitly free them when you are done. Temp allocated bytes don't 
-// have be freed in reverse allocation order. I.e. you can allocate A then B, 
+// need to explicitly free them when you are done. Temp allocated bytes don't
+// have be freed in reverse allocation order. I.e. you can allocate A then B,
 // and aftewards free A then B.
 
+// Every thread has its own temp arena. The main thread's arena is the back of
+// the hunk; other threads get a MEM_TEMP_THREAD_BYTES block from the heap the
+// first time they allocate. Objects are stacked downwards from the end of the
+// arena, each with a small header. Freeing an object marks its header; space
+// is reclaimed as soon as everything below it on the stack is freed as well,
+// so every free is O(1) amortized. Objects that don't fit into a thread arena
+// go to the heap directly. Temp objects must be freed by the thread that
+// allocated them.
+
 void *mem_temp_alloc(uint32_t size) {
-	size = round_up_to_word(size);
+	if (!arena) {
+		thread_arena.base = malloc(MEM_TEMP_THREAD_BYTES);
+		error_if(!thread_arena.base, "Failed to allocate %d bytes for temp mem", MEM_TEMP_THREAD_BYTES);
+		thread_arena.size = MEM_TEMP_THREAD_BYTES;
+		arena = &thread_arena;
+	}
 
-	error_if(bump_len + temp_len + size >= MEM_HUNK_BYTES, "Failed to allocate %d bytes in temp mem", size);
-	error_if(temp_objects_len >= MEM_TEMP_OBJECTS_MAX, "MEM_TEMP_OBJECTS_MAX reached");
+	size = round_up_to_word(size) + sizeof(temp_header_t);
+	temp_header_t *header;
 
-	temp_len += size;
-	void *p = &hunk[MEM_HUNK_BYTES - temp_len];
-	temp_objects[temp_objects_len++] = temp_len;
-	return p;
+	uint32_t used = arena == &hunk_arena ? bump_len : 0;
+	if (used + arena->len + size < arena->size) {
+		arena->len += size;
+		header = (temp_header_t *)&arena->base[arena->size - arena->len];
+		header->flags = 0;
+	}
+	else {
+		error_if(arena == &hunk_arena, "Failed to allocate %d bytes in temp mem", size);
+		header = malloc(size);
+		error_if(!header, "Failed to allocate %d bytes in temp heap", size);
+		header->flags = TEMP_FLAG_HEAP;
+	}
+	header->size = size;
+	arena->objects_len++;
+
+	if (arena == &hunk_arena) {
+		temp_len = arena->len;
+		temp_high = max(temp_high, temp_len);
+		hunk_high = max(hunk_high, bump_len + temp_len);
+	}
+	return header + 1;
 }
 
 void mem_temp_free(void *p) {
-	uint32_t offset = (uint8_t *)&hunk[MEM_HUNK_BYTES] - (uint8_t *)p;
-	error_if(offset > MEM_HUNK_BYTES, "Object 0x%p not in temp hunk", p);
-
-	bool found = false;
-	uint32_t remaining_max = 0;
-	for (int i = 0; i < temp_objects_len; i++) {
-		if (temp_objects[i] == offset) {
-			temp_objects[i--] = temp_objects[--temp_objects_len];
-			found = true;
-		}
-		else if (temp_objects[i] > remaining_max) {
-			remaining_max = temp_objects[i];
+	error_if(!arena || arena->objects_len == 0, "Object 0x%p not in temp mem", p);
+	temp_header_t *header = (temp_header_t *)p - 1;
+	arena->objects_len--;
+
+	if (header->flags & TEMP_FLAG_HEAP) {
+		free(header);
+		return;
+	}
+
+	uint32_t offset = &arena->base[arena->size] - (uint8_t *)header;
+	error_if(offset > arena->len || (header->flags & TEMP_FLAG_FREED), "Object 0x%p not in temp mem", p);
+	header->flags |= TEMP_FLAG_FREED;
+
+	// Pop all freed objects from the top of the stack
+	while (arena->len > 0) {
+		header = (temp_header_t *)&arena->base[arena->size - arena->len];
+		if (!(header->flags & TEMP_FLAG_FREED)) {
+			break;
 		}
+		arena->len -= header->size;
+	}
+
+	if (arena == &hunk_arena) {
+		temp_len = arena->len;
 	}
-	error_if(!found, "Object 0x%p not in temp hunk", p);
-	temp_len = remaining_max;
 }
 
 void mem_temp_check(void) {
-	error_if(temp_len != 0, "Temp memory not free: %d object(s)", temp_objects_len);
+	error_if(arena && arena->objects_len != 0, "Temp memory not free: %d object(s)", arena->objects_len);
+}
+
+// Releases the temp arena of the calling thread. Threads that used temp mem
+// call this before they exit.
+
+void mem_temp_release_thread(void) {
+	if (arena == &thread_arena) {
+		mem_temp_check();
+		free(thread_arena.base);
+		thread_arena = (temp_arena_t){0};
+		arena = NULL;
+	}
+}
+
+
+
+// Memory accounting - only the main thread allocates from the hunk, so none
+// of this is locked
+
+mem_tag_t mem_set_tag(mem_tag_t tag) {
+	mem_tag_t previous = tag_current;
+	tag_current = tag;
+	return previous;
+}
+
+// Prints the current and peak bytes for each tag and the highest hunk level
+// since the previous dump, e.g. the high water mark of the scene that is about
+// to be released.
+
+void mem_dump(const char *label) {
+	hunk_peak = max(hunk_peak, hunk_high);
+	printf(
+		"mem %s: %.2f MB used, %.2f MB high water, %.2f MB peak, %.2f MB hunk\n",
+		label, (bump_len + temp_len) / (1024.0 * 1024.0), hunk_high / (1024.0 * 1024.0),
+		hunk_peak / (1024.0 * 1024.0), hunk_size / (1024.0 * 1024.0)
+	);
+	for (int i = 0; i < NUM_MEM_TAGS; i++) {
+		if (tag_bytes_peak[i]) {
+			printf("  %-10s %8.1f KB, peak %8.1f KB\n", tag_names[i], tag_bytes[i] / 1024.0, tag_bytes_peak[i] / 1024.0);
+		}
+	}
+	hunk_high = bump_len + temp_len;
 }
@@ -3,16 +3,48 @@
 
 #include "types.h"
 
-#define MEM_TEMP_OBJECTS_MAX 8
-#define MEM_HUNK_BYTES (16 * 1024 * 1024)
+// Size of the temp arena of each thread other than the main thread
+#define MEM_TEMP_THREAD_BYTES (4 * 1024 * 1024)
+
+// Default hunk size; the hunk is only committed as it is used on platforms
+// with virtual memory, so reserving a lot is cheap there
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+	#define MEM_HUNK_BYTES (256 * 1024 * 1024)
+#else
+	#define MEM_HUNK_BYTES (16 * 1024 * 1024)
+#endif
+#define MEM_DECOMMIT_MIN_BYTES (256 * 1024)
+
+// Tags for the memory accounting of bump allocations. Allocations are
+// attributed to the tag that was set with mem_set_tag() at the time.
+typedef enum {
+	MEM_TAG_NONE,
+	MEM_TAG_UI,
+	MEM_TAG_TEXTURES,
+	MEM_TAG_TRACK,
+	MEM_TAG_SCENE,
+	MEM_TAG_OBJECTS,
+	MEM_TAG_SFX,
+	MEM_TAG_PARTICLES,
+	MEM_TAG_WEAPONS,
+	NUM_MEM_TAGS
+} mem_tag_t;
+
+#define MEM_TAG_SPANS_MAX 8192
+
+void mem_init(uint32_t size);
+mem_tag_t mem_set_tag(mem_tag_t tag);
+void mem_dump(const char *label);
 
 void *mem_bump(uint32_t size);
 void *mem_bump_unaligned(uint32_t size);
+void *mem_bump_uninit(uint32_t size);
 void *mem_mark(void);
 void mem_reset(void *p);
 
 void *mem_temp_alloc(uint32_t size);
 void mem_temp_free(void *p);
 void mem_temp_check(void);
+void mem_temp_release_thread(void);
 
 #endif
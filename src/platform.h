@@ -3,6 +3,8 @@
 
 #include "types.h"
 
+#define PLATFORM_PATH_MAX 1024
+
 void platform_exit(void);
 vec2i_t platform_screen_size(void);
 double platform_now(void);
@@ -12,8 +14,13 @@ void platform_set_audio_mix_cb(void (*cb)(float *buffer, uint32_t len));
 
 FILE *platform_open_asset(const char *name, const char *mode);
 uint8_t *platform_load_asset(const char *name, uint32_t *bytes_read);
+uint8_t *platform_map_asset(const char *name, uint32_t *bytes_read);
+void platform_unmap_asset(uint8_t *bytes, uint32_t len);
 uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read);
 uint32_t platform_store_userdata(const char *name, void *bytes, int32_t len);
+FILE *platform_open_userdata(const char *name, const char *mode);
+uint8_t *platform_map_userdata(const char *name, uint32_t *bytes_read);
+void platform_unmap_userdata(uint8_t *bytes, uint32_t len);
 
 #if defined(RENDERER_SOFTWARE)
 	rgba_t *platform_get_screenbuffer(int32_t *pitch);
@@ -2,10 +2,10 @@
 #include "system.h"
 #include "utils.h"
 #include "mem.h"
+#include "replay.h"
 
 static char *path_assets = "";		// optionally set by -DPATH_ASSETS
 static char *path_userdata = "";	// optionally set by -DPATH_USERDATA
-static char *temp_path = NULL;		// buffer alloc'd in main()
 
 void platform_exit(void) {}
 vec2i_t platform_screen_size(void) {
@@ -24,16 +24,32 @@ void platform_set_audio_mix_cb(void (*cb)(float *buffer, uint32_t len)) {
 	(void) cb;
 }
 
+// Paths are assembled in a per thread buffer, so that assets can also be
+// loaded from the background thread
+static char *platform_path(const char *dir, const char *name) {
+	static thread_local char temp_path[PLATFORM_PATH_MAX];
+	error_if(strlen(dir) + strlen(name) >= PLATFORM_PATH_MAX, "Path too long: %s%s", dir, name);
+	return strcat(strcpy(temp_path, dir), name);
+}
 FILE *platform_open_asset(const char *name, const char *mode) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return fopen(path, mode);
 }
 uint8_t *platform_load_asset(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return file_load(path, bytes_read);
 }
+uint8_t *platform_map_asset(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_assets, name);
+	uint8_t *bytes = file_map(path, bytes_read);
+	error_if(!bytes, "Could not open file for reading: %s", path);
+	return bytes;
+}
+void platform_unmap_asset(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
 uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	if (!file_exists(path)) {
 		*bytes_read = 0;
 		return NULL;
@@ -41,9 +57,20 @@ uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
 	return file_load(path, bytes_read);
 }
 uint32_t platform_store_userdata(const char *name, void *bytes, int32_t len) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	return file_store(path, bytes, len);
 }
+FILE *platform_open_userdata(const char *name, const char *mode) {
+	char *path = platform_path(path_userdata, name);
+	return fopen(path, mode);
+}
+uint8_t *platform_map_userdata(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_userdata, name);
+	return file_map(path, bytes_read);
+}
+void platform_unmap_userdata(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
 
 int main(int argc, char *argv[]) {
 	(void) argc; (void) argv;
@@ -63,10 +90,6 @@ int main(int argc, char *argv[]) {
 		path_userdata = "";
 	#endif
 
-	// Reserve some space for concatenating the asset and userdata paths with
-	// local filenames.
-	temp_path = mem_bump(max(strlen(path_assets), strlen(path_userdata)) + 64);
-
 	// This is the bare minimum, which will still go through the motions of
 	// loading assets, e.g.:
 	//
@@ -95,7 +118,12 @@ int main(int argc, char *argv[]) {
 	// load: wipeout/common/ebolt.prm
 	// open music track 1
 	system_init();
-	system_update();
+
+	// Run a single frame, or all frames of a replay given in WIPEOUT_REPLAY
+	do {
+		system_update();
+	} while (replay_is_playing());
+
 	system_cleanup();
 
 	return 0;
@@ -14,7 +14,6 @@ static SDL_GameController *gamepad;
 static void (*audio_callback)(float *buffer, uint32_t len) = NULL;
 static char *path_assets = "";
 static char *path_userdata = "";
-static char *temp_path = NULL;
 
 
 uint8_t platform_sdl_gamepad_map[] = {
@@ -228,18 +227,37 @@ void platform_set_audio_mix_cb(void (*cb)(float *buffer, uint32_t len)) {
 }
 
 
+// Paths are assembled in a per thread buffer, so that assets can also be
+// loaded from the background thread
+static char *platform_path(const char *dir, const char *name) {
+	static thread_local char temp_path[PLATFORM_PATH_MAX];
+	error_if(strlen(dir) + strlen(name) >= PLATFORM_PATH_MAX, "Path too long: %s%s", dir, name);
+	return strcat(strcpy(temp_path, dir), name);
+}
+
 FILE *platform_open_asset(const char *name, const char *mode) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return fopen(path, mode);
 }
 
 uint8_t *platform_load_asset(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return file_load(path, bytes_read);
 }
 
+uint8_t *platform_map_asset(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_assets, name);
+	uint8_t *bytes = file_map(path, bytes_read);
+	error_if(!bytes, "Could not open file for reading: %s", path);
+	return bytes;
+}
+
+void platform_unmap_asset(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
+
 uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	if (!file_exists(path)) {
 		*bytes_read = 0;
 		return NULL;
@@ -248,10 +266,24 @@ uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
 }
 
 uint32_t platform_store_userdata(const char *name, void *bytes, int32_t len) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	return file_store(path, bytes, len);
 }
 
+FILE *platform_open_userdata(const char *name, const char *mode) {
+	char *path = platform_path(path_userdata, name);
+	return fopen(path, mode);
+}
+
+uint8_t *platform_map_userdata(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_userdata, name);
+	return file_map(path, bytes_read);
+}
+
+void platform_unmap_userdata(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
+
 #if defined(RENDERER_GL) // ----------------------------------------------------
 	#define PLATFORM_WINDOW_FLAGS SDL_WINDOW_OPENGL
 	SDL_GLContext platform_gl;
@@ -372,13 +404,9 @@ int main(int argc, char *argv[]) {
 		}
 	#endif
 
-	// Reserve some space for concatenating the asset and userdata paths with
-	// local filenames.
-	temp_path = mem_bump(max(strlen(path_assets), strlen(path_userdata)) + 64);
-
 	// Load gamecontrollerdb.txt if present.
 	// FIXME: Should this load from userdata instead?
-	char *gcdb_path = strcat(strcpy(temp_path, path_assets), "gamecontrollerdb.txt");
+	char *gcdb_path = platform_path(path_assets, "gamecontrollerdb.txt");
 	int gcdb_res = SDL_GameControllerAddMappingsFromFile(gcdb_path);
 	if (gcdb_res < 0) {
 		printf("Failed to load gamecontrollerdb.txt\n");
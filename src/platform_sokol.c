@@ -33,7 +33,6 @@
 	static const char *path_userdata = "";
 #endif
 
-static char *temp_path;
 
 static const uint8_t keyboard_map[] = {
 	[SAPP_KEYCODE_SPACE] = INPUT_KEY_SPACE,
@@ -264,18 +263,37 @@ void platform_set_audio_mix_cb(void (*cb)(float *buffer, uint32_t len)) {
 	audio_callback = cb;
 }
 
+// Paths are assembled in a per thread buffer, so that assets can also be
+// loaded from the background thread
+static char *platform_path(const char *dir, const char *name) {
+	static thread_local char temp_path[PLATFORM_PATH_MAX];
+	error_if(strlen(dir) + strlen(name) >= PLATFORM_PATH_MAX, "Path too long: %s%s", dir, name);
+	return strcat(strcpy(temp_path, dir), name);
+}
+
 FILE *platform_open_asset(const char *name, const char *mode) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return fopen(path, mode);
 }
 
 uint8_t *platform_load_asset(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_assets), name);
+	char *path = platform_path(path_assets, name);
 	return file_load(path, bytes_read);
 }
 
+uint8_t *platform_map_asset(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_assets, name);
+	uint8_t *bytes = file_map(path, bytes_read);
+	error_if(!bytes, "Could not open file for reading: %s", path);
+	return bytes;
+}
+
+void platform_unmap_asset(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
+
 uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	if (!file_exists(path)) {
 		*bytes_read = 0;
 		return NULL;
@@ -284,18 +302,30 @@ uint8_t *platform_load_userdata(const char *name, uint32_t *bytes_read) {
 }
 
 uint32_t platform_store_userdata(const char *name, void *bytes, int32_t len) {
-	char *path = strcat(strcpy(temp_path, path_userdata), name);
+	char *path = platform_path(path_userdata, name);
 	return file_store(path, bytes, len);
 }
 
+FILE *platform_open_userdata(const char *name, const char *mode) {
+	char *path = platform_path(path_userdata, name);
+	return fopen(path, mode);
+}
+
+uint8_t *platform_map_userdata(const char *name, uint32_t *bytes_read) {
+	char *path = platform_path(path_userdata, name);
+	return file_map(path, bytes_read);
+}
+
+void platform_unmap_userdata(uint8_t *bytes, uint32_t len) {
+	file_unmap(bytes, len);
+}
+
 void platform_cleanup() {
 	system_cleanup();
 	saudio_shutdown();
 }
 
 sapp_desc sokol_main(int argc, char* argv[]) {
-	temp_path = mem_bump(max(strlen(path_assets), strlen(path_userdata)) + 64);
-
 	stm_setup();
 
 	saudio_setup(&(saudio_desc){
@@ -0,0 +1,77 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "profile.h"
+#include "platform.h"
+#include "utils.h"
+
+#if defined(PROFILE)
+
+typedef struct {
+	const char *name;
+	double time;
+	uint32_t thread;
+	char phase;
+} profile_event_t;
+
+// Events from all threads go into one ring that keeps the last
+// PROFILE_EVENTS_MAX of them. A slot is claimed with an atomic increment.
+// Writing the trace sets stopped and waits for writers still in flight, so
+// no slot is written while it is read (e.g. by the audio thread).
+static profile_event_t events[PROFILE_EVENTS_MAX];
+static _Atomic uint32_t events_len = 0;
+static _Atomic uint32_t threads_len = 0;
+static _Atomic uint32_t writers = 0;
+static atomic_bool stopped = false;
+static thread_local uint32_t thread_id = 0;
+
+void profile_event(const char *name, char phase) {
+	atomic_fetch_add(&writers, 1);
+	if (atomic_load(&stopped)) {
+		atomic_fetch_sub(&writers, 1);
+		return;
+	}
+	if (!thread_id) {
+		thread_id = atomic_fetch_add(&threads_len, 1) + 1;
+	}
+	uint32_t index = atomic_fetch_add_explicit(&events_len, 1, memory_order_relaxed);
+	events[index % PROFILE_EVENTS_MAX] = (profile_event_t){name, platform_now(), thread_id, phase};
+	atomic_fetch_sub(&writers, 1);
+}
+
+void profile_write_trace(FILE *file) {
+	atomic_store(&stopped, true);
+	while (atomic_load(&writers) != 0) {}
+
+	uint32_t len = atomic_load(&events_len);
+	uint32_t start = len > PROFILE_EVENTS_MAX ? len - PROFILE_EVENTS_MAX : 0;
+
+	// After the ring wrapped, the oldest zones may have lost their begin
+	// event; skip ends without a matching begin on the same thread
+	uint32_t *depth = calloc(atomic_load(&threads_len) + 1, sizeof(uint32_t));
+	uint32_t written = 0;
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (uint32_t i = start; i < len; i++) {
+		profile_event_t *e = &events[i % PROFILE_EVENTS_MAX];
+		if (e->phase == 'B') {
+			depth[e->thread]++;
+		}
+		else if (depth[e->thread] > 0) {
+			depth[e->thread]--;
+		}
+		else if (start > 0) {
+			continue;
+		}
+		fprintf(
+			file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}\n",
+			written ? "," : "", e->name, e->phase, e->time * 1000000.0, e->thread
+		);
+		written++;
+	}
+	fprintf(file, "]}\n");
+	free(depth);
+	printf("profile: wrote %u events\n", written);
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+
+// Profiling zones. Build with -DPROFILE to record every zone into a ring
+// buffer of the last PROFILE_EVENTS_MAX events; the buffer is written as
+// Chrome trace_event JSON on exit (open it in chrome://tracing or Perfetto).
+// Without PROFILE the macros compile to nothing.
+
+#define PROFILE_EVENTS_MAX (1 << 18)
+
+#if defined(PROFILE)
+	#define PROFILE_BEGIN(NAME) profile_event(NAME, 'B')
+	#define PROFILE_END(NAME) profile_event(NAME, 'E')
+
+	void profile_event(const char *name, char phase);
+	void profile_write_trace(FILE *file);
+#else
+	#define PROFILE_BEGIN(NAME)
+	#define PROFILE_END(NAME)
+#endif
+
+#endif
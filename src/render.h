@@ -20,9 +20,33 @@ typedef enum {
 	NUM_RENDER_POST_EFFCTS,
 } render_post_effect_t;
 
+// Why the buffered tris had to be drawn; also used to count the state
+// changes that can cause a flush
+typedef enum {
+	RENDER_FLUSH_BUFFER_FULL,
+	RENDER_FLUSH_FRAME,
+	RENDER_FLUSH_VIEW,
+	RENDER_FLUSH_MODEL_MAT,
+	RENDER_FLUSH_DEPTH,
+	RENDER_FLUSH_BLEND,
+	RENDER_FLUSH_CULL,
+	RENDER_FLUSH_TEXTURES,
+	NUM_RENDER_FLUSH_CAUSES
+} render_flush_cause_t;
+
 typedef struct {
 	uint32_t num_tris;
 	uint32_t num_draw_calls;
+	uint32_t num_vertex_bytes;
+	uint32_t num_state_changes[NUM_RENDER_FLUSH_CAUSES];
+	uint32_t num_flushes[NUM_RENDER_FLUSH_CAUSES];
+
+	// Only counted by the software renderer; the GPU does this for GL
+	uint32_t num_tris_culled;
+	uint32_t num_tris_clipped;
+	uint32_t num_pixels;
+
+	double flush_time;
 } render_stats_t;
 
 #define RENDER_USE_MIPMAPS 1
@@ -61,6 +85,23 @@ void render_push_sprite(vec3_t pos, vec2i_t size, rgba_t color, uint16_t texture
 void render_push_2d(vec2i_t pos, vec2i_t size, rgba_t color, uint16_t texture);
 void render_push_2d_tile(vec2i_t pos, vec2i_t uv_offset, vec2i_t uv_size, vec2i_t size, rgba_t color, uint16_t texture_index);
 
+// Push a run of prebuilt 2d tris, translated by pos and drawn with color. The
+// uvs are in texel coordinates of texture_index, as with render_push_tris().
+void render_push_2d_tris(const tris_t *tris, uint32_t len, vec2i_t pos, rgba_t color, uint16_t texture_index);
+
+// Retained 2d layers. 2d draws between render_layer_begin() and
+// render_layer_end() go into an offscreen buffer of the given size instead of
+// the screen; render_layer_draw() composites that buffer in one go, until it
+// is rendered again. Only the software renderer keeps layers, since that is
+// where the 2d fill rate matters; elsewhere render_layer_begin() returns false
+// and the caller should draw directly. Additive blending is not supported
+// within a layer.
+#define RENDER_LAYERS_MAX 4
+
+bool render_layer_begin(uint16_t layer, vec2i_t size);
+void render_layer_end(void);
+void render_layer_draw(uint16_t layer, vec2i_t pos);
+
 uint16_t render_texture_create(uint32_t width, uint32_t height, rgba_t *pixels);
 vec2i_t render_texture_size(uint16_t texture_index);
 void render_texture_replace_pixels(int16_t texture_index, rgba_t *pixels);
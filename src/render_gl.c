@@ -26,9 +26,11 @@
 #include <stb_image_write.h>
 
 #include "system.h"
+#include "platform.h"
 #include "render.h"
 #include "mem.h"
 #include "utils.h"
+#include "profile.h"
 
 
 #define ATLAS_SIZE 64
@@ -38,6 +40,10 @@
 #define RENDER_TRIS_BUFFER_CAPACITY 2048
 #define TEXTURES_MAX 1024
 
+#define RENDER_UPLOAD_BUFFERS 4
+#define RENDER_UPLOAD_BUFFER_BYTES (4 * 1024 * 1024)
+#define RENDER_UPLOADS_MAX 256
+
 
 #if defined(__EMSCRIPTEN__) || defined(USE_GLES2)
 	// WebGL (GLES) needs the `precision` to be set, wheras OpenGL 2 
@@ -50,12 +56,17 @@
 	#define NEAR_PLANE 128.0
 	#define FAR_PLANE (RENDER_FADEOUT_FAR)
 	#define RENDER_DEPTH_BUFFER_INTERNAL_FORMAT GL_DEPTH_COMPONENT16
+
+	// Neither GLES2 nor WebGL support mapping pixel unpack buffers, so 
+	// texture uploads go directly through glTexSubImage2D
+	#define RENDER_USE_UPLOAD_BUFFERS 0
 #else
 	#define SHADER_SOURCE(...) #__VA_ARGS__
 
 	#define NEAR_PLANE 16.0
 	#define FAR_PLANE (RENDER_FADEOUT_FAR)
 	#define RENDER_DEPTH_BUFFER_INTERNAL_FORMAT GL_DEPTH_COMPONENT24
+	#define RENDER_USE_UPLOAD_BUFFERS 1
 #endif
 	
 
@@ -64,6 +75,14 @@ typedef struct {
 	vec2i_t size;
 } render_texture_t;
 
+typedef struct {
+	uint32_t buffer_offset;
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+} render_upload_t;
+
 uint16_t RENDER_NO_TEXTURE;
 
 #define use_program(SHADER) \
@@ -369,6 +388,18 @@ static render_texture_t textures[TEXTURES_MAX];
 static uint32_t textures_len = 0;
 static bool texture_mipmap_is_dirty = false;
 
+// Texture uploads are staged in a ring of pixel unpack buffers. The border
+// expanded pixels are written directly into the mapped buffer and all pending
+// uploads are submitted in one batch, the next time we draw or the buffer is
+// full. This lets the driver copy asynchronously while we decode the next
+// images.
+static GLuint upload_buffers[RENDER_UPLOAD_BUFFERS];
+static uint32_t upload_buffer_index = 0;
+static uint8_t *upload_buffer_mapped = NULL;
+static uint32_t upload_buffer_len = 0;
+static render_upload_t uploads[RENDER_UPLOADS_MAX];
+static uint32_t uploads_len = 0;
+
 static render_resolution_t render_res;
 static GLuint backbuffer = 0;
 static GLuint backbuffer_texture = 0;
@@ -384,7 +415,8 @@ static render_stats_t running_stats = {0};
 static render_stats_t end_stats = {0};
 
 
-static void render_flush(void);
+static void render_flush(render_flush_cause_t cause);
+static void render_uploads_flush(void);
 
 
 // static void gl_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam) {
@@ -431,6 +463,13 @@ void render_init(vec2i_t screen_size) {
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
 
+	// Texture upload buffers
+
+	#if RENDER_USE_UPLOAD_BUFFERS
+		glGenBuffers(RENDER_UPLOAD_BUFFERS, upload_buffers);
+	#endif
+
+
 	// Post Shaders
 
 	prg_post_effects[RENDER_POST_NONE] = shader_post_default_init();
@@ -591,12 +630,12 @@ void render_frame_prepare(void) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST); 
 
-	running_stats.num_tris = 0;
-	running_stats.num_draw_calls = 0;
+	running_stats = (render_stats_t){0};
 }
 
 void render_frame_end(void) {
-	render_flush();
+	render_uploads_flush();
+	render_flush(RENDER_FLUSH_FRAME);
 
 	use_program(prg_post);
 
@@ -626,7 +665,7 @@ void render_frame_end(void) {
 		}
 	};
 
-	render_flush();
+	render_flush(RENDER_FLUSH_FRAME);
 	
 	// Only here do we have the complete stats
 	memcpy(&end_stats, &running_stats, sizeof(render_stats_t));
@@ -636,11 +675,14 @@ const render_stats_t* render_frame_get_stats(void) {
 	return &end_stats;
 }
 
-void render_flush(void) {
+void render_flush(render_flush_cause_t cause) {
 	if (tris_len == 0) {
 		return;
 	}
 
+	PROFILE_BEGIN("render_flush");
+	double flush_start = platform_now();
+	render_uploads_flush();
 	if (texture_mipmap_is_dirty) {
 		glGenerateMipmap(GL_TEXTURE_2D);
 		texture_mipmap_is_dirty = false;
@@ -648,16 +690,23 @@ void render_flush(void) {
 
 	running_stats.num_tris += tris_len;
 	running_stats.num_draw_calls++;
+	running_stats.num_vertex_bytes += sizeof(tris_t) * tris_len;
+	running_stats.num_flushes[cause]++;
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(tris_t) * tris_len, tris_buffer, GL_DYNAMIC_DRAW);
 	glDrawArrays(GL_TRIANGLES, 0, tris_len * 3);
 	tris_len = 0;
+
+	// CPU time only; the driver may still be busy with the draw call
+	running_stats.flush_time += platform_now() - flush_start;
+	PROFILE_END("render_flush");
 }
 
 
 void render_set_view(vec3_t pos, vec3_t angles) {
-	render_flush();
+	render_flush(RENDER_FLUSH_VIEW);
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
 	render_set_depth_write(true);
 	render_set_depth_test(true);
 
@@ -669,7 +718,7 @@ void render_set_view(vec3_t pos, vec3_t angles) {
 
 	render_set_model_mat(&mat4_identity());
 
-	render_flush();
+	render_flush(RENDER_FLUSH_VIEW);
 	glUniformMatrix4fv(prg_game->uniform.view, 1, false, view_mat.m);
 	glUniformMatrix4fv(prg_game->uniform.projection, 1, false, projection_mat_3d.m);
 	glUniform3f(prg_game->uniform.camera_pos, pos.x, pos.y, pos.z);
@@ -677,7 +726,8 @@ void render_set_view(vec3_t pos, vec3_t angles) {
 }
 
 void render_set_view_2d(void) {
-	render_flush();
+	render_flush(RENDER_FLUSH_VIEW);
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
 	render_set_depth_test(false);
 	render_set_depth_write(false);
 
@@ -688,17 +738,20 @@ void render_set_view_2d(void) {
 }
 
 void render_set_model_mat(mat4_t *m) {
-	render_flush();
+	render_flush(RENDER_FLUSH_MODEL_MAT);
+	running_stats.num_state_changes[RENDER_FLUSH_MODEL_MAT]++;
 	glUniformMatrix4fv(prg_game->uniform.model, 1, false, m->m);
 }
 
 void render_set_depth_write(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	glDepthMask(enabled);
 }
 
 void render_set_depth_test(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	if (enabled) {
 		glEnable(GL_DEPTH_TEST);
 	}
@@ -708,7 +761,8 @@ void render_set_depth_test(bool enabled) {
 }
 
 void render_set_depth_offset(float offset) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	if (offset == 0) {
 		glDisable(GL_POLYGON_OFFSET_FILL);
 		return;	
@@ -719,7 +773,8 @@ void render_set_depth_offset(float offset) {
 }
 
 void render_set_screen_position(vec2_t pos) {
-	render_flush();
+	render_flush(RENDER_FLUSH_VIEW);
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
 	glUniform2f(prg_game->uniform.screen, pos.x, -pos.y);
 }
 
@@ -727,7 +782,8 @@ void render_set_blend_mode(render_blend_mode_t new_mode) {
 	if (new_mode == blend_mode) {
 		return;
 	}
-	render_flush();
+	render_flush(RENDER_FLUSH_BLEND);
+	running_stats.num_state_changes[RENDER_FLUSH_BLEND]++;
 
 	blend_mode = new_mode;
 	if (blend_mode == RENDER_BLEND_NORMAL) {
@@ -739,7 +795,8 @@ void render_set_blend_mode(render_blend_mode_t new_mode) {
 }
 
 void render_set_cull_backface(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_CULL);
+	running_stats.num_state_changes[RENDER_FLUSH_CULL]++;
 	if (enabled) {
 		glEnable(GL_CULL_FACE);
 	}
@@ -759,7 +816,7 @@ void render_push_tris(tris_t tris, uint16_t texture_index) {
 	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
 	
 	if (tris_len >= RENDER_TRIS_BUFFER_CAPACITY) {
-		render_flush();
+		render_flush(RENDER_FLUSH_BUFFER_FULL);
 	}
 
 	render_texture_t *t = &textures[texture_index];
@@ -774,10 +831,17 @@ void render_push_tris(tris_t tris, uint16_t texture_index) {
 void render_push_sprite(vec3_t pos, vec2i_t size, rgba_t color, uint16_t texture_index) {
 	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
 
-	vec3_t p1 = vec3_add(pos, vec3_transform(vec3(-size.x * 0.5, -size.y * 0.5, 0), &sprite_mat));
-	vec3_t p2 = vec3_add(pos, vec3_transform(vec3( size.x * 0.5, -size.y * 0.5, 0), &sprite_mat));
-	vec3_t p3 = vec3_add(pos, vec3_transform(vec3(-size.x * 0.5,  size.y * 0.5, 0), &sprite_mat));
-	vec3_t p4 = vec3_add(pos, vec3_transform(vec3( size.x * 0.5,  size.y * 0.5, 0), &sprite_mat));
+	vec3_t corners[4] = {
+		vec3(-size.x * 0.5, -size.y * 0.5, 0),
+		vec3( size.x * 0.5, -size.y * 0.5, 0),
+		vec3(-size.x * 0.5,  size.y * 0.5, 0),
+		vec3( size.x * 0.5,  size.y * 0.5, 0)
+	};
+	vec3_transform_array(corners, corners, 4, &sprite_mat);
+	vec3_t p1 = vec3_add(pos, corners[0]);
+	vec3_t p2 = vec3_add(pos, corners[1]);
+	vec3_t p3 = vec3_add(pos, corners[2]);
+	vec3_t p4 = vec3_add(pos, corners[3]);
 
 	render_texture_t *t = &textures[texture_index];
 	render_push_tris((tris_t){
@@ -867,6 +931,148 @@ void render_push_2d_tile(vec2i_t pos, vec2i_t uv_offset, vec2i_t uv_size, vec2i_
 	}, texture_index);
 }
 
+void render_push_2d_tris(const tris_t *tris, uint32_t len, vec2i_t pos, rgba_t color, uint16_t texture_index) {
+	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
+	error_if(len > RENDER_TRIS_BUFFER_CAPACITY, "Too many tris in run %d", len);
+
+	if (tris_len + len > RENDER_TRIS_BUFFER_CAPACITY) {
+		render_flush(RENDER_FLUSH_BUFFER_FULL);
+	}
+
+	// Copy the whole run straight into the buffer; only the translation, the
+	// atlas offset and the color need to be applied.
+	render_texture_t *t = &textures[texture_index];
+	tris_t *out = &tris_buffer[tris_len];
+	for (uint32_t i = 0; i < len; i++) {
+		for (int j = 0; j < 3; j++) {
+			vertex_t v = tris[i].vertices[j];
+			v.pos.x += pos.x;
+			v.pos.y += pos.y;
+			v.uv.x += t->offset.x;
+			v.uv.y += t->offset.y;
+			v.color = color;
+			out[i].vertices[j] = v;
+		}
+	}
+	tris_len += len;
+}
+
+// Layers would need a render target per layer and a way to sample it; the
+// GPU does the 2d overlay fast enough, so everything is just drawn directly.
+bool render_layer_begin(uint16_t layer, vec2i_t size) {
+	(void) layer; (void) size;
+	return false;
+}
+
+void render_layer_end(void) {}
+
+void render_layer_draw(uint16_t layer, vec2i_t pos) {
+	(void) layer; (void) pos;
+}
+
+
+static void render_texture_add_border(rgba_t *pb, uint32_t tw, uint32_t th, rgba_t *pixels) {
+	uint32_t bw = tw + ATLAS_BORDER * 2;
+	uint32_t bh = th + ATLAS_BORDER * 2;
+
+	if (!tw || !th) {
+		return;
+	}
+
+	// Top border
+	for (int32_t y = 0; y < ATLAS_BORDER; y++) {
+		memcpy(pb + bw * y + ATLAS_BORDER, pixels, tw * sizeof(rgba_t));
+	}
+
+	// Bottom border
+	for (int32_t y = 0; y < ATLAS_BORDER; y++) {
+		memcpy(pb + bw * (bh - ATLAS_BORDER + y) + ATLAS_BORDER, pixels + tw * (th-1), tw * sizeof(rgba_t));
+	}
+	
+	// Left border
+	for (int32_t y = 0; y < bh; y++) {
+		for (int32_t x = 0; x < ATLAS_BORDER; x++) {
+			pb[y * bw + x] = pixels[clamp(y-ATLAS_BORDER, 0, th-1) * tw];
+		}
+	}
+
+	// Right border
+	for (int32_t y = 0; y < bh; y++) {
+		for (int32_t x = 0; x < ATLAS_BORDER; x++) {
+			pb[y * bw + x + bw - ATLAS_BORDER] = pixels[tw - 1 + clamp(y-ATLAS_BORDER, 0, th-1) * tw];
+		}
+	}
+
+	// Texture
+	for (int32_t y = 0; y < th; y++) {
+		memcpy(pb + bw * (y + ATLAS_BORDER) + ATLAS_BORDER, pixels + tw * y, tw * sizeof(rgba_t));
+	}
+}
+
+static rgba_t *render_upload_alloc(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+	#if RENDER_USE_UPLOAD_BUFFERS
+		uint32_t size = width * height * sizeof(rgba_t);
+		if (size > RENDER_UPLOAD_BUFFER_BYTES) {
+			return NULL;
+		}
+
+		if (
+			upload_buffer_mapped && 
+			(upload_buffer_len + size > RENDER_UPLOAD_BUFFER_BYTES || uploads_len >= RENDER_UPLOADS_MAX)
+		) {
+			render_uploads_flush();
+		}
+
+		// Orphan the previous storage of this buffer, so that mapping it never
+		// has to wait for an upload still in flight
+		if (!upload_buffer_mapped) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffers[upload_buffer_index]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, RENDER_UPLOAD_BUFFER_BYTES, NULL, GL_STREAM_DRAW);
+			upload_buffer_mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			upload_buffer_len = 0;
+			if (!upload_buffer_mapped) {
+				return NULL;
+			}
+		}
+
+		rgba_t *p = (rgba_t *)(upload_buffer_mapped + upload_buffer_len);
+		uploads[uploads_len++] = (render_upload_t){
+			.buffer_offset = upload_buffer_len,
+			.x = x, .y = y, .width = width, .height = height
+		};
+		upload_buffer_len += size;
+		return p;
+	#else
+		(void) x; (void) y; (void) width; (void) height;
+		return NULL;
+	#endif
+}
+
+static void render_uploads_flush(void) {
+	#if RENDER_USE_UPLOAD_BUFFERS
+		if (!upload_buffer_mapped) {
+			return;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffers[upload_buffer_index]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindTexture(GL_TEXTURE_2D, atlas_texture);
+		for (uint32_t i = 0; i < uploads_len; i++) {
+			render_upload_t *u = &uploads[i];
+			glTexSubImage2D(
+				GL_TEXTURE_2D, 0, u->x, u->y, u->width, u->height, 
+				GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)(uintptr_t)u->buffer_offset
+			);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		upload_buffer_mapped = NULL;
+		upload_buffer_len = 0;
+		uploads_len = 0;
+		upload_buffer_index = (upload_buffer_index + 1) % RENDER_UPLOAD_BUFFERS;
+	#endif
+}
 
 uint16_t render_texture_create(uint32_t tw, uint32_t th, rgba_t *pixels) {
 	error_if(textures_len >= TEXTURES_MAX, "TEXTURES_MAX reached");
@@ -910,46 +1116,23 @@ uint16_t render_texture_create(uint32_t tw, uint32_t th, rgba_t *pixels) {
 		atlas_map[cx] = grid_y + grid_height;
 	}
 
-	// Add the border pixels for this texture
-	rgba_t *pb = mem_temp_alloc(sizeof(rgba_t) * bw * bh);
-
-	if (tw && th) {
-		// Top border
-		for (int32_t y = 0; y < ATLAS_BORDER; y++) {
-			memcpy(pb + bw * y + ATLAS_BORDER, pixels, tw * sizeof(rgba_t));
-		}
-
-		// Bottom border
-		for (int32_t y = 0; y < ATLAS_BORDER; y++) {
-			memcpy(pb + bw * (bh - ATLAS_BORDER + y) + ATLAS_BORDER, pixels + tw * (th-1), tw * sizeof(rgba_t));
-		}
-		
-		// Left border
-		for (int32_t y = 0; y < bh; y++) {
-			for (int32_t x = 0; x < ATLAS_BORDER; x++) {
-				pb[y * bw + x] = pixels[clamp(y-ATLAS_BORDER, 0, th-1) * tw];
-			}
-		}
-
-		// Right border
-		for (int32_t y = 0; y < bh; y++) {
-			for (int32_t x = 0; x < ATLAS_BORDER; x++) {
-				pb[y * bw + x + bw - ATLAS_BORDER] = pixels[tw - 1 + clamp(y-ATLAS_BORDER, 0, th-1) * tw];
-			}
-		}
-
-		// Texture
-		for (int32_t y = 0; y < th; y++) {
-			memcpy(pb + bw * (y + ATLAS_BORDER) + ATLAS_BORDER, pixels + tw * y, tw * sizeof(rgba_t));
-		}
-	}
-
 	uint32_t x = grid_x * ATLAS_GRID;
 	uint32_t y = grid_y * ATLAS_GRID;
-	glBindTexture(GL_TEXTURE_2D, atlas_texture);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, bw, bh, GL_RGBA, GL_UNSIGNED_BYTE, pb);
-	mem_temp_free(pb);
 
+	// Write the bordered texture into a staged upload buffer if we can,
+	// otherwise upload it right away.
+	rgba_t *pb = render_upload_alloc(x, y, bw, bh);
+	if (pb) {
+		render_texture_add_border(pb, tw, th, pixels);
+	}
+	else {
+		render_uploads_flush();
+		pb = mem_temp_alloc(sizeof(rgba_t) * bw * bh);
+		render_texture_add_border(pb, tw, th, pixels);
+		glBindTexture(GL_TEXTURE_2D, atlas_texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, bw, bh, GL_RGBA, GL_UNSIGNED_BYTE, pb);
+		mem_temp_free(pb);
+	}
 
 	texture_mipmap_is_dirty = RENDER_USE_MIPMAPS;
 	uint16_t texture_index = textures_len;
@@ -969,6 +1152,7 @@ void render_texture_replace_pixels(int16_t texture_index, rgba_t *pixels) {
 	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
 
 	render_texture_t *t = &textures[texture_index];
+	render_uploads_flush();
 	glBindTexture(GL_TEXTURE_2D, atlas_texture);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, t->offset.x, t->offset.y, t->size.x, t->size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 }
@@ -979,7 +1163,8 @@ uint16_t render_textures_len(void) {
 
 void render_textures_reset(uint16_t len) {
 	error_if(len > textures_len, "Invalid texture reset len %d >= %d", len, textures_len);
-	render_flush();
+	render_flush(RENDER_FLUSH_TEXTURES);
+	running_stats.num_state_changes[RENDER_FLUSH_TEXTURES]++;
 
 	textures_len = len;
 	clear(atlas_map);
@@ -1010,6 +1195,7 @@ void render_textures_dump(const char *path) {
 	int width = ATLAS_SIZE * ATLAS_GRID;
 	int height = ATLAS_SIZE * ATLAS_GRID;
 	rgba_t *pixels = malloc(sizeof(rgba_t) * width * height);
+	render_uploads_flush();
 	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 	stbi_write_png(path, width, height, 4, pixels, 0);
 	free(pixels);
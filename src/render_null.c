@@ -69,6 +69,18 @@ void render_push_2d(vec2i_t pos, vec2i_t size, rgba_t color, uint16_t texture) {
 void render_push_2d_tile(vec2i_t pos, vec2i_t uv_offset, vec2i_t uv_size, vec2i_t size, rgba_t color, uint16_t texture_index) {
 	(void) pos; (void) uv_offset; (void) uv_size; (void) size; (void) color; (void) texture_index;
 }
+void render_push_2d_tris(const tris_t *tris, uint32_t len, vec2i_t pos, rgba_t color, uint16_t texture_index) {
+	(void) tris; (void) len; (void) pos; (void) color; (void) texture_index;
+}
+
+bool render_layer_begin(uint16_t layer, vec2i_t size) {
+	(void) layer; (void) size;
+	return false;
+}
+void render_layer_end(void) {}
+void render_layer_draw(uint16_t layer, vec2i_t pos) {
+	(void) layer; (void) pos;
+}
 
 uint16_t render_texture_create(uint32_t width, uint32_t height, rgba_t *pixels) {
 	(void) width; (void) height; (void) pixels;
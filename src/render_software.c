@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "platform.h"
 #include "types.h"
+#include "profile.h"
 
 #define NEAR_PLANE 16.0
 #define FAR_PLANE (RENDER_FADEOUT_FAR)
@@ -27,7 +28,7 @@ typedef struct {
 } clip_tris_t;
 
 static void draw_tris(clip_tris_t t);
-static void render_flush(void);
+static void render_flush(render_flush_cause_t cause);
 
 static rgba_t *screen_buffer;
 static int32_t screen_pitch;
@@ -50,6 +51,19 @@ static mat4_t sprite_mat = mat4_identity();
 static render_texture_t textures[TEXTURES_MAX];
 static uint32_t textures_len;
 
+// Retained 2d layers and the screen state to return to after rendering one
+static render_texture_t layers[RENDER_LAYERS_MAX];
+static uint32_t layers_capacity[RENDER_LAYERS_MAX];
+static bool layer_active = false;
+static struct {
+	rgba_t *buffer;
+	int32_t ppr;
+	vec2i_t size;
+	mat4_t mvp_mat;
+	bool depth_write_enabled;
+	bool depth_test_enabled;
+} layer_saved;
+
 uint16_t RENDER_NO_TEXTURE;
 
 int32_t tris_buffer_len = 0;
@@ -76,6 +90,12 @@ void render_cleanup(void) {
 	free(depth_buffer);
 	depth_buffer = NULL;
 	depth_buffer_len = 0;
+
+	for (int i = 0; i < RENDER_LAYERS_MAX; i++) {
+		free(layers[i].pixels);
+		layers[i] = (render_texture_t){0};
+		layers_capacity[i] = 0;
+	}
 }
 
 void render_set_screen_size(vec2i_t size) {
@@ -127,12 +147,11 @@ void render_frame_prepare(void) {
 		depth_buffer[i] = 1.0f;
 	}
 
-	running_stats.num_tris = 0;
-	running_stats.num_draw_calls = 0;
+	running_stats = (render_stats_t){0};
 }
 
 void render_frame_end(void) {
-	render_flush();
+	render_flush(RENDER_FLUSH_FRAME);
 	memcpy(&end_stats, &running_stats, sizeof(render_stats_t));
 }
 
@@ -141,6 +160,7 @@ const render_stats_t* render_frame_get_stats(void) {
 }
 
 void render_set_view(vec3_t pos, vec3_t angles) {
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
 	render_set_depth_write(true);
 	render_set_depth_test(true);
 
@@ -154,6 +174,7 @@ void render_set_view(vec3_t pos, vec3_t angles) {
 }
 
 void render_set_view_2d(void) {
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
 	render_set_depth_test(false);
 	render_set_depth_write(false);
 
@@ -175,32 +196,43 @@ void render_set_view_2d(void) {
 }
 
 void render_set_model_mat(mat4_t *m) {
+	running_stats.num_state_changes[RENDER_FLUSH_MODEL_MAT]++;
 	mat4_t vm_mat;
 	mat4_mul(&vm_mat, &view_mat, m);
 	mat4_mul(&mvp_mat, &projection_mat, &vm_mat);
 }
 
 void render_set_depth_write(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	depth_write_enabled = enabled;
 }
 void render_set_depth_test(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	depth_test_enabled = enabled;
 }
 void render_set_depth_offset(float offset) {
-	render_flush();
+	render_flush(RENDER_FLUSH_DEPTH);
+	running_stats.num_state_changes[RENDER_FLUSH_DEPTH]++;
 	depth_offset = offset;
 }
-void render_set_screen_position(vec2_t pos) {}
+void render_set_screen_position(vec2_t pos) {
+	running_stats.num_state_changes[RENDER_FLUSH_VIEW]++;
+}
 
-void render_set_blend_mode(render_blend_mode_t mode) {
-	render_flush();
-	blend_mode = mode;
+void render_set_blend_mode(render_blend_mode_t new_mode) {
+	if (new_mode == blend_mode) {
+		return;
+	}
+	render_flush(RENDER_FLUSH_BLEND);
+	running_stats.num_state_changes[RENDER_FLUSH_BLEND]++;
+	blend_mode = new_mode;
 }
 
 void render_set_cull_backface(bool enabled) {
-	render_flush();
+	render_flush(RENDER_FLUSH_CULL);
+	running_stats.num_state_changes[RENDER_FLUSH_CULL]++;
 	cull_backface_enabled = enabled;
 }
 
@@ -218,7 +250,13 @@ static int sort_sw_tris_by_depth(const void *a, const void *b) {
 	return za - zb;
 }
 
-static void render_flush(void) {
+static void render_flush(render_flush_cause_t cause) {
+	if (tris_buffer_len == 0) {
+		return;
+	}
+
+	PROFILE_BEGIN("render_flush");
+	double flush_start = platform_now();
 	// Sort tris by depth and draw front to back to minimize overdraw. The final
 	// pixel color calculation is only a small part of the whole triangle
 	// rasterization, but it still helps a little to skip it when depth testing.
@@ -228,11 +266,15 @@ static void render_flush(void) {
 	running_stats.num_tris += tris_buffer_len;
 	// Not draw calls but draw buffer sorts
 	running_stats.num_draw_calls++;
+	running_stats.num_vertex_bytes += sizeof(clip_tris_t) * tris_buffer_len;
+	running_stats.num_flushes[cause]++;
 
 	for (int i = 0; i < tris_buffer_len; i++) {
 		draw_tris(tris_buffer[i]);
 	}
 	tris_buffer_len = 0;
+	running_stats.flush_time += platform_now() - flush_start;
+	PROFILE_END("render_flush");
 }
 
 static vec4_t rgba_to_vec4(rgba_t c) {
@@ -281,7 +323,7 @@ static int clip_near(clip_vert_t *in, int in_len, clip_vert_t *out) {
 
 void render_push_tris(tris_t tris, uint16_t texture_index) {
 	if (tris_buffer_len >= TRIS_BUFFER_SIZE - 8) {
-		render_flush();
+		render_flush(RENDER_FLUSH_BUFFER_FULL);
 	}
 
 	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
@@ -291,16 +333,27 @@ void render_push_tris(tris_t tris, uint16_t texture_index) {
 	vec4_t color1 = rgba_to_vec4(tris.vertices[1].color);
 	vec4_t color2 = rgba_to_vec4(tris.vertices[2].color);
 
+	vec3_t pos[3] = {tris.vertices[0].pos, tris.vertices[1].pos, tris.vertices[2].pos};
+	vec4_t clip_pos[3];
+	vec3_transform_perspective_array(pos, clip_pos, 3, &mvp_mat);
+
 	clip_vert_t in[3] = {
-		{.clip_pos = vec3_transform_perspective(tris.vertices[0].pos, &mvp_mat), .uv = tris.vertices[0].uv, .color = color0},
-		{.clip_pos = vec3_transform_perspective(tris.vertices[1].pos, &mvp_mat), .uv = tris.vertices[1].uv, .color = color1},
-		{.clip_pos = vec3_transform_perspective(tris.vertices[2].pos, &mvp_mat), .uv = tris.vertices[2].uv, .color = color2},
+		{.clip_pos = clip_pos[0], .uv = tris.vertices[0].uv, .color = color0},
+		{.clip_pos = clip_pos[1], .uv = tris.vertices[1].uv, .color = color1},
+		{.clip_pos = clip_pos[2], .uv = tris.vertices[2].uv, .color = color2},
 	};
 	clip_vert_t clipped[8];
 	int clipped_len = clip_near(in, len(in), clipped);
 	if (clipped_len < 3) {
+		running_stats.num_tris_culled++;
 		return;
 	}
+	for (int i = 0; i < len(in); i++) {
+		if (in[i].clip_pos.z < -in[i].clip_pos.w) {
+			running_stats.num_tris_clipped++;
+			break;
+		}
+	}
 
 	// Perspective divide the screen space tris now. We don't need the original
 	// position anymore, so just overwrite.
@@ -322,10 +375,17 @@ void render_push_tris(tris_t tris, uint16_t texture_index) {
 void render_push_sprite(vec3_t pos, vec2i_t size, rgba_t color, uint16_t texture_index) {
 	error_if(texture_index >= textures_len, "Invalid texture %d", texture_index);
 
-	vec3_t p0 = vec3_add(pos, vec3_transform(vec3(-size.x * 0.5, -size.y * 0.5, 0), &sprite_mat));
-	vec3_t p1 = vec3_add(pos, vec3_transform(vec3( size.x * 0.5, -size.y * 0.5, 0), &sprite_mat));
-	vec3_t p2 = vec3_add(pos, vec3_transform(vec3(-size.x * 0.5,  size.y * 0.5, 0), &sprite_mat));
-	vec3_t p3 = vec3_add(pos, vec3_transform(vec3( size.x * 0.5,  size.y * 0.5, 0), &sprite_mat));
+	vec3_t corners[4] = {
+		vec3(-size.x * 0.5, -size.y * 0.5, 0),
+		vec3( size.x * 0.5, -size.y * 0.5, 0),
+		vec3(-size.x * 0.5,  size.y * 0.5, 0),
+		vec3( size.x * 0.5,  size.y * 0.5, 0)
+	};
+	vec3_transform_array(corners, corners, 4, &sprite_mat);
+	vec3_t p0 = vec3_add(pos, corners[0]);
+	vec3_t p1 = vec3_add(pos, corners[1]);
+	vec3_t p2 = vec3_add(pos, corners[2]);
+	vec3_t p3 = vec3_add(pos, corners[3]);
 
 	render_texture_t *t = &textures[texture_index];
 	render_push_tris((tris_t){
@@ -367,6 +427,18 @@ void render_push_2d_tile(vec2i_t pos, vec2i_t uv_offset, vec2i_t uv_size, vec2i_
 	}, texture_index);
 }
 
+void render_push_2d_tris(const tris_t *tris, uint32_t len, vec2i_t pos, rgba_t color, uint16_t texture_index) {
+	for (uint32_t i = 0; i < len; i++) {
+		tris_t t = tris[i];
+		for (int j = 0; j < 3; j++) {
+			t.vertices[j].pos.x += pos.x;
+			t.vertices[j].pos.y += pos.y;
+			t.vertices[j].color = color;
+		}
+		render_push_tris(t, texture_index);
+	}
+}
+
 
 uint16_t render_texture_create(uint32_t width, uint32_t height, rgba_t *pixels) {
 	error_if(textures_len >= TEXTURES_MAX, "TEXTURES_MAX reached");
@@ -374,7 +446,9 @@ uint16_t render_texture_create(uint32_t width, uint32_t height, rgba_t *pixels)
 	uint32_t byte_size = width * height * sizeof(rgba_t);
 	uint16_t texture_index = textures_len;
 	
-	textures[texture_index] = (render_texture_t){{width, height}, mem_bump(byte_size)};
+	mem_tag_t tag = mem_set_tag(MEM_TAG_TEXTURES);
+	textures[texture_index] = (render_texture_t){{width, height}, mem_bump_uninit(byte_size)};
+	mem_set_tag(tag);
 	memcpy(textures[texture_index].pixels, pixels, byte_size);
 
 	textures_len++;
@@ -398,6 +472,7 @@ uint16_t render_textures_len(void) {
 
 void render_textures_reset(uint16_t len) {
 	error_if(len > textures_len, "Invalid texture reset len %d >= %d", len, textures_len);
+	running_stats.num_state_changes[RENDER_FLUSH_TEXTURES]++;
 	textures_len = len;
 }
 
@@ -458,6 +533,7 @@ void draw_tris(clip_tris_t t) {
 	if (cull_backface_enabled) {
 		float signed_area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
 		if (signed_area <= 0.0f) {
+			running_stats.num_tris_culled++;
 			return;
 		}
 	}
@@ -508,6 +584,7 @@ void draw_tris(clip_tris_t t) {
 	float depth_bias = 0.5f + (depth_offset / FAR_PLANE);
 	int32_t y_start = max((int32_t)ceilf(v[0].p.y - 0.5f), 0);
 	int32_t y_end   = min((int32_t)floorf(v[2].p.y - 0.5f), (int32_t)screen_size.y - 1);
+	uint32_t pixels_written = 0;
 
 	for (int32_t y = y_start; y <= y_end; y++) {
 		float py = y + 0.5f;
@@ -577,15 +654,18 @@ void draw_tris(clip_tris_t t) {
 						.a = (uint8_t)(texel.a * c.w + 0.5)
 					};
 
+					// The screen is always opaque; a transparent pixel can only be
+					// in a layer, where the alpha is kept for compositing.
 					screen_ptr[i] = blend_mode == RENDER_BLEND_LIGHTER
 						? color_add(screen_ptr[i], color)
-						: color.a == 255 
+						: color.a == 255 || screen_ptr[i].a == 0
 							? color 
 							: color_mix(screen_ptr[i], color);
 
 					if (depth_write_enabled) {
 						depth_ptr[i] = depth;
 					}
+					pixels_written++;
 				}
 			}
 			it_current.z += it_gradient.z;
@@ -594,4 +674,83 @@ void draw_tris(clip_tris_t t) {
 			it_current.col_q = vec4_add(it_current.col_q, it_gradient.col_q);
 		}
 	}
+	running_stats.num_pixels += pixels_written;
+}
+
+
+// Layers ----------------------------------------------------------------------
+
+bool render_layer_begin(uint16_t layer, vec2i_t size) {
+	error_if(layer >= RENDER_LAYERS_MAX, "Invalid layer %d", layer);
+	error_if(layer_active, "Layer already active");
+	error_if(size.x <= 0 || size.y <= 0, "Invalid layer size %d x %d", size.x, size.y);
+	render_flush(RENDER_FLUSH_VIEW);
+
+	// Layers are resized with the ui scale, so like the depth buffer they live
+	// outside of the hunk.
+	render_texture_t *l = &layers[layer];
+	uint32_t pixel_count = (uint32_t)size.x * (uint32_t)size.y;
+	if (pixel_count > layers_capacity[layer]) {
+		rgba_t *resized = realloc(l->pixels, pixel_count * sizeof(rgba_t));
+		error_if(resized == NULL, "Failed to allocate layer");
+		l->pixels = resized;
+		layers_capacity[layer] = pixel_count;
+	}
+	l->size = size;
+	memset(l->pixels, 0, pixel_count * sizeof(rgba_t));
+
+	layer_saved.buffer = screen_buffer;
+	layer_saved.ppr = screen_ppr;
+	layer_saved.size = screen_size;
+	layer_saved.mvp_mat = mvp_mat;
+	layer_saved.depth_write_enabled = depth_write_enabled;
+	layer_saved.depth_test_enabled = depth_test_enabled;
+
+	screen_buffer = l->pixels;
+	screen_ppr = size.x;
+	screen_size = size;
+	render_set_view_2d();
+	layer_active = true;
+	return true;
+}
+
+void render_layer_end(void) {
+	error_if(!layer_active, "No layer active");
+	render_flush(RENDER_FLUSH_VIEW);
+
+	screen_buffer = layer_saved.buffer;
+	screen_ppr = layer_saved.ppr;
+	screen_size = layer_saved.size;
+	mvp_mat = layer_saved.mvp_mat;
+	depth_write_enabled = layer_saved.depth_write_enabled;
+	depth_test_enabled = layer_saved.depth_test_enabled;
+	layer_active = false;
+}
+
+void render_layer_draw(uint16_t layer, vec2i_t pos) {
+	error_if(layer >= RENDER_LAYERS_MAX, "Invalid layer %d", layer);
+	render_flush(RENDER_FLUSH_VIEW);
+
+	// Blit with the same blending the tris had when drawn to the screen
+	// directly; pixels that were never touched stay transparent.
+	render_texture_t *l = &layers[layer];
+	int32_t x_s = max(pos.x, 0);
+	int32_t x_e = min(pos.x + l->size.x, screen_size.x);
+	int32_t y_s = max(pos.y, 0);
+	int32_t y_e = min(pos.y + l->size.y, screen_size.y);
+	for (int32_t y = y_s; y < y_e; y++) {
+		rgba_t *src = l->pixels + l->size.x * (y - pos.y) + (x_s - pos.x);
+		rgba_t *dst = screen_buffer + screen_ppr * y + x_s;
+		for (int32_t x = x_s; x < x_e; x++, src++, dst++) {
+			if (src->a == 255) {
+				*dst = *src;
+			}
+			else if (src->a > 0) {
+				*dst = color_mix(*dst, *src);
+			}
+		}
+	}
+	if (x_e > x_s && y_e > y_s) {
+		running_stats.num_pixels += (x_e - x_s) * (y_e - y_s);
+	}
 }
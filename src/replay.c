@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "input.h"
+#include "platform.h"
+#include "system.h"
+
+// File layout: magic, version and seed, followed by one record per frame:
+// tick (double), changed, pressed and released action masks (uint32), then
+// one float state for every action whose bit is set in changed.
+
+typedef enum {
+	REPLAY_OFF,
+	REPLAY_RECORD,
+	REPLAY_PLAY
+} replay_mode_t;
+
+static replay_mode_t mode = REPLAY_OFF;
+static FILE *file;
+static uint32_t seed;
+static uint32_t frames;
+static double start_time;
+static input_actions_t last_actions;
+
+static void replay_open(const char *path, replay_mode_t new_mode) {
+	file = fopen(path, new_mode == REPLAY_RECORD ? "wb" : "rb");
+	if (!file) {
+		printf("Failed to open replay %s\n", path);
+		return;
+	}
+
+	char magic[4];
+	uint32_t version = REPLAY_VERSION;
+	if (new_mode == REPLAY_RECORD) {
+		fwrite(REPLAY_MAGIC, 4, 1, file);
+		fwrite(&version, sizeof(version), 1, file);
+		fwrite(&seed, sizeof(seed), 1, file);
+		printf("Recording replay %s\n", path);
+	}
+	else if (
+		fread(magic, 4, 1, file) != 1 || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+		fread(&version, sizeof(version), 1, file) != 1 || version != REPLAY_VERSION ||
+		fread(&seed, sizeof(seed), 1, file) != 1
+	) {
+		printf("Invalid replay %s\n", path);
+		fclose(file);
+		file = NULL;
+		return;
+	}
+	else {
+		printf("Playing replay %s\n", path);
+	}
+
+	mode = new_mode;
+	start_time = platform_now();
+}
+
+void replay_init(void) {
+	seed = (uint32_t)(platform_now() * 100);
+	memset(&last_actions, 0, sizeof(last_actions));
+	frames = 0;
+
+	char *path = getenv("WIPEOUT_REPLAY");
+	if (path && path[0]) {
+		replay_open(path, REPLAY_PLAY);
+		return;
+	}
+
+	path = getenv("WIPEOUT_RECORD");
+	if (path && path[0]) {
+		replay_open(path, REPLAY_RECORD);
+	}
+}
+
+void replay_cleanup(void) {
+	if (file) {
+		fclose(file);
+		file = NULL;
+	}
+	mode = REPLAY_OFF;
+}
+
+uint32_t replay_seed(void) {
+	return seed;
+}
+
+bool replay_is_playing(void) {
+	return mode == REPLAY_PLAY;
+}
+
+static void replay_record_frame(double tick) {
+	input_actions_t actions;
+	input_actions_get(&actions);
+
+	uint32_t changed = 0;
+	for (int i = 0; i < INPUT_ACTION_MAX; i++) {
+		if (actions.state[i] != last_actions.state[i]) {
+			changed |= 1u << i;
+		}
+	}
+
+	bool written =
+		fwrite(&tick, sizeof(tick), 1, file) == 1 &&
+		fwrite(&changed, sizeof(changed), 1, file) == 1 &&
+		fwrite(&actions.pressed, sizeof(actions.pressed), 1, file) == 1 &&
+		fwrite(&actions.released, sizeof(actions.released), 1, file) == 1;
+	for (int i = 0; i < INPUT_ACTION_MAX && written; i++) {
+		if (changed & (1u << i)) {
+			written = fwrite(&actions.state[i], sizeof(float), 1, file) == 1;
+		}
+	}
+	last_actions = actions;
+
+	// Playback stops at the first incomplete frame, so there is no point in
+	// recording any further
+	if (!written) {
+		printf("Replay recording truncated after %u frames\n", frames);
+		replay_cleanup();
+	}
+}
+
+static bool replay_play_frame(double *tick) {
+	double frame_tick;
+	uint32_t changed;
+	input_actions_t actions = last_actions;
+	if (
+		fread(&frame_tick, sizeof(frame_tick), 1, file) != 1 ||
+		fread(&changed, sizeof(changed), 1, file) != 1 ||
+		fread(&actions.pressed, sizeof(actions.pressed), 1, file) != 1 ||
+		fread(&actions.released, sizeof(actions.released), 1, file) != 1
+	) {
+		return false;
+	}
+	for (int i = 0; i < INPUT_ACTION_MAX; i++) {
+		if ((changed & (1u << i)) && fread(&actions.state[i], sizeof(float), 1, file) != 1) {
+			return false;
+		}
+	}
+
+	input_actions_set(&actions);
+	last_actions = actions;
+	*tick = frame_tick;
+	return true;
+}
+
+double replay_frame(double tick) {
+	if (mode == REPLAY_RECORD) {
+		replay_record_frame(tick);
+		frames++;
+	}
+	else if (mode == REPLAY_PLAY) {
+		if (replay_play_frame(&tick)) {
+			frames++;
+		}
+		else {
+			double duration = platform_now() - start_time;
+			printf(
+				"Replay finished: %u frames in %.2fs (%.3fms/frame)\n",
+				frames, duration, frames ? (duration * 1000.0) / frames : 0
+			);
+			replay_cleanup();
+			system_exit();
+		}
+	}
+	return tick;
+}
@@ -0,0 +1,26 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "types.h"
+
+// Deterministic input recording and playback. With WIPEOUT_RECORD=<path> the
+// rng seed and, for every frame, the frame tick and the action state are
+// written to a file. With WIPEOUT_REPLAY=<path> that file is played back in
+// place of live input and real time, as fast as the platform runs, so the
+// simulation takes exactly the same steps. Text input and key captures (e.g.
+// highscore names) are not recorded.
+
+#define REPLAY_MAGIC "WRPL"
+#define REPLAY_VERSION 1
+
+void replay_init(void);
+void replay_cleanup(void);
+
+// The seed to use for the game's rng; the recorded one during playback
+uint32_t replay_seed(void);
+bool replay_is_playing(void);
+
+// Records or plays back one frame. Returns the tick to use for this frame.
+double replay_frame(double tick);
+
+#endif
@@ -1,9 +1,14 @@
+#include <stdlib.h>
+
 #include "system.h"
 #include "input.h"
 #include "render.h"
 #include "platform.h"
 #include "mem.h"
 #include "utils.h"
+#include "jobs.h"
+#include "profile.h"
+#include "replay.h"
 
 #include "wipeout/game.h"
 
@@ -12,17 +17,90 @@ static double time_scaled;
 static double time_scale = 1.0;
 static double tick_last;
 static double cycle_time = 0;
+static FILE *render_stats_file;
+static uint32_t render_stats_frame;
+
+static void system_write_render_stats(void) {
+	const render_stats_t *stats = render_frame_get_stats();
+	FILE *f = render_stats_file;
+	fprintf(f, "{\"frame\":%u,\"time\":%.6f,\"tris\":%u,\"draw_calls\":%u,\"vertex_bytes\":%u,",
+		render_stats_frame++, time_real, stats->num_tris, stats->num_draw_calls, stats->num_vertex_bytes
+	);
+	fprintf(f, "\"tris_culled\":%u,\"tris_clipped\":%u,\"pixels\":%u,\"flush_time\":%.6f,",
+		stats->num_tris_culled, stats->num_tris_clipped, stats->num_pixels, stats->flush_time
+	);
+
+	static const char *cause_names[] = {
+		[RENDER_FLUSH_BUFFER_FULL] = "buffer_full",
+		[RENDER_FLUSH_FRAME] = "frame",
+		[RENDER_FLUSH_VIEW] = "view",
+		[RENDER_FLUSH_MODEL_MAT] = "model_mat",
+		[RENDER_FLUSH_DEPTH] = "depth",
+		[RENDER_FLUSH_BLEND] = "blend",
+		[RENDER_FLUSH_CULL] = "cull",
+		[RENDER_FLUSH_TEXTURES] = "textures",
+	};
+	fprintf(f, "\"flushes\":{");
+	for (int i = 0; i < NUM_RENDER_FLUSH_CAUSES; i++) {
+		fprintf(f, "%s\"%s\":%u", i ? "," : "", cause_names[i], stats->num_flushes[i]);
+	}
+	fprintf(f, "},\"state_changes\":{");
+	for (int i = 0; i < NUM_RENDER_FLUSH_CAUSES; i++) {
+		fprintf(f, "%s\"%s\":%u", i ? "," : "", cause_names[i], stats->num_state_changes[i]);
+	}
+	fprintf(f, "}}\n");
+}
 
 void system_init(void) {
 	time_real = platform_now();
+
+	// The hunk size can be raised for mods with bigger assets, e.g.
+	// WIPEOUT_HUNK_MB=1024
+	uint32_t hunk_size = MEM_HUNK_BYTES;
+	char *hunk_mb = getenv("WIPEOUT_HUNK_MB");
+	if (hunk_mb && atoi(hunk_mb) > 0) {
+		hunk_size = min(atoi(hunk_mb), 2047) * 1024 * 1024;
+	}
+	mem_init(hunk_size);
+
+	jobs_init();
 	input_init();
+	replay_init();
 	render_init(platform_screen_size());
+
+	// Per frame render stats as JSON lines, e.g.
+	// WIPEOUT_RENDER_STATS=render_stats.jsonl
+	char *render_stats_path = getenv("WIPEOUT_RENDER_STATS");
+	if (render_stats_path && render_stats_path[0]) {
+		render_stats_file = fopen(render_stats_path, "wb");
+		if (!render_stats_file) {
+			printf("Failed to open render stats file %s\n", render_stats_path);
+		}
+	}
+
 	game_init();
 }
 
 void system_cleanup(void) {
+	game_cleanup();
+
+	#if defined(PROFILE)
+		FILE *trace = platform_open_userdata("trace.json", "wb");
+		if (trace) {
+			profile_write_trace(trace);
+			fclose(trace);
+		}
+	#endif
+
+	if (render_stats_file) {
+		fclose(render_stats_file);
+		render_stats_file = NULL;
+	}
+
+	replay_cleanup();
 	render_cleanup();
 	input_cleanup();
+	jobs_cleanup();
 }
 
 void system_exit(void) {
@@ -30,10 +108,11 @@ void system_exit(void) {
 }
 
 void system_update(void) {
+	PROFILE_BEGIN("system_update");
 	double time_real_now = platform_now();
 	double real_delta = time_real_now - time_real;
 	time_real = time_real_now;
-	tick_last = min(real_delta, 0.1) * time_scale;
+	tick_last = replay_frame(min(real_delta, 0.1) * time_scale);
 	time_scaled += tick_last;
 
 	// FIXME: come up with a better way to wrap the cycle_time, so that it
@@ -48,8 +127,12 @@ void system_update(void) {
 	game_update();
 
 	render_frame_end();
+	if (render_stats_file) {
+		system_write_render_stats();
+	}
 	input_clear();
 	mem_temp_check();
+	PROFILE_END("system_update");
 }
 
 void system_reset_cycle_time(void) {
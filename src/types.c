@@ -2,6 +2,40 @@
 #include "types.h"
 #include "utils.h"
 
+// 4 wide float vectors for the matrix transforms. Every lane computes the
+// same mul and add sequence as the scalar code, so results are identical.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define TYPES_SIMD
+	typedef __m128 simd4_t;
+	#define simd4_load(P) _mm_loadu_ps(P)
+	#define simd4_store(P, V) _mm_storeu_ps(P, V)
+	#define simd4_set1(F) _mm_set1_ps(F)
+	#define simd4_add(A, B) _mm_add_ps(A, B)
+	#define simd4_mul(A, B) _mm_mul_ps(A, B)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define TYPES_SIMD
+	typedef float32x4_t simd4_t;
+	#define simd4_load(P) vld1q_f32(P)
+	#define simd4_store(P, V) vst1q_f32(P, V)
+	#define simd4_set1(F) vdupq_n_f32(F)
+	#define simd4_add(A, B) vaddq_f32(A, B)
+	#define simd4_mul(A, B) vmulq_f32(A, B)
+#endif
+
+#if defined(TYPES_SIMD)
+	// c0 * x + c1 * y + c2 * z + c3
+	static inline simd4_t simd4_transform(simd4_t c0, simd4_t c1, simd4_t c2, simd4_t c3, float x, float y, float z) {
+		return simd4_add(simd4_add(simd4_add(
+			simd4_mul(c0, simd4_set1(x)),
+			simd4_mul(c1, simd4_set1(y))),
+			simd4_mul(c2, simd4_set1(z))),
+			c3
+		);
+	}
+#endif
+
 rgba_t rgba_from_u32(uint32_t v) {
 	return rgba(
 		((v >> 24) & 0xff),
@@ -27,20 +61,62 @@ float vec3_angle(vec3_t a, vec3_t b) {
 }
 
 vec3_t vec3_transform(vec3_t a, mat4_t *mat) {
-	return vec3(
-		mat->m[0] * a.x + mat->m[4] * a.y + mat->m[ 8] * a.z + mat->m[12],
-		mat->m[1] * a.x + mat->m[5] * a.y + mat->m[ 9] * a.z + mat->m[13],
-		mat->m[2] * a.x + mat->m[6] * a.y + mat->m[10] * a.z + mat->m[14]
-	);
+	vec3_t res;
+	vec3_transform_array(&a, &res, 1, mat);
+	return res;
 }
 
 vec4_t vec3_transform_perspective(vec3_t a, mat4_t *mat) {
-	return vec4(
-		mat->m[0] * a.x + mat->m[4] * a.y + mat->m[ 8] * a.z + mat->m[12],
-		mat->m[1] * a.x + mat->m[5] * a.y + mat->m[ 9] * a.z + mat->m[13],
-		mat->m[2] * a.x + mat->m[6] * a.y + mat->m[10] * a.z + mat->m[14],
-		mat->m[3] * a.x + mat->m[7] * a.y + mat->m[11] * a.z + mat->m[15]
-	);
+	vec4_t res;
+	vec3_transform_perspective_array(&a, &res, 1, mat);
+	return res;
+}
+
+void vec3_transform_array(const vec3_t *in, vec3_t *out, uint32_t len, mat4_t *mat) {
+#if defined(TYPES_SIMD)
+	simd4_t c0 = simd4_load(mat->cols[0]);
+	simd4_t c1 = simd4_load(mat->cols[1]);
+	simd4_t c2 = simd4_load(mat->cols[2]);
+	simd4_t c3 = simd4_load(mat->cols[3]);
+	for (uint32_t i = 0; i < len; i++) {
+		float v[4];
+		simd4_store(v, simd4_transform(c0, c1, c2, c3, in[i].x, in[i].y, in[i].z));
+		out[i] = vec3(v[0], v[1], v[2]);
+	}
+#else
+	for (uint32_t i = 0; i < len; i++) {
+		vec3_t a = in[i];
+		out[i] = vec3(
+			mat->m[0] * a.x + mat->m[4] * a.y + mat->m[ 8] * a.z + mat->m[12],
+			mat->m[1] * a.x + mat->m[5] * a.y + mat->m[ 9] * a.z + mat->m[13],
+			mat->m[2] * a.x + mat->m[6] * a.y + mat->m[10] * a.z + mat->m[14]
+		);
+	}
+#endif
+}
+
+void vec3_transform_perspective_array(const vec3_t *in, vec4_t *out, uint32_t len, mat4_t *mat) {
+#if defined(TYPES_SIMD)
+	simd4_t c0 = simd4_load(mat->cols[0]);
+	simd4_t c1 = simd4_load(mat->cols[1]);
+	simd4_t c2 = simd4_load(mat->cols[2]);
+	simd4_t c3 = simd4_load(mat->cols[3]);
+	for (uint32_t i = 0; i < len; i++) {
+		float v[4];
+		simd4_store(v, simd4_transform(c0, c1, c2, c3, in[i].x, in[i].y, in[i].z));
+		out[i] = vec4(v[0], v[1], v[2], v[3]);
+	}
+#else
+	for (uint32_t i = 0; i < len; i++) {
+		vec3_t a = in[i];
+		out[i] = vec4(
+			mat->m[0] * a.x + mat->m[4] * a.y + mat->m[ 8] * a.z + mat->m[12],
+			mat->m[1] * a.x + mat->m[5] * a.y + mat->m[ 9] * a.z + mat->m[13],
+			mat->m[2] * a.x + mat->m[6] * a.y + mat->m[10] * a.z + mat->m[14],
+			mat->m[3] * a.x + mat->m[7] * a.y + mat->m[11] * a.z + mat->m[15]
+		);
+	}
+#endif
 }
 
 vec3_t vec4_perspective_divide(vec4_t a) {
@@ -64,10 +140,10 @@ vec3_t vec3_reflect(vec3_t incidence, vec3_t normal, float f) {
 	return vec3_add(incidence, vec3_mulf(normal, vec3_dot(normal, vec3_mulf(incidence, -1)) * f));
 }
 
-vec3_t vec3_rand(float maxlen) {
+vec3_t vec3_rand(rand_t *r, float maxlen) {
 	vec3_t v;
 	do {
-		v = vec3(rand_float(-1, 1), rand_float(-1, 1), rand_float(-1, 1));
+		v = vec3(rand_float(r, -1, 1), rand_float(r, -1, 1), rand_float(r, -1, 1));
 	} while (vec3_len_sq(v) > 1);
 	return vec3_mulf(v, maxlen);
 }
@@ -124,6 +200,25 @@ void mat4_translate(mat4_t *mat, vec3_t translation) {
 }
 
 void mat4_mul(mat4_t *res, mat4_t *a, mat4_t *b) {
+#if defined(TYPES_SIMD)
+	simd4_t c0 = simd4_load(a->cols[0]);
+	simd4_t c1 = simd4_load(a->cols[1]);
+	simd4_t c2 = simd4_load(a->cols[2]);
+	simd4_t c3 = simd4_load(a->cols[3]);
+	simd4_t r[4];
+	for (int i = 0; i < 4; i++) {
+		float *bc = b->cols[i];
+		r[i] = simd4_add(simd4_add(simd4_add(
+			simd4_mul(c0, simd4_set1(bc[0])),
+			simd4_mul(c1, simd4_set1(bc[1]))),
+			simd4_mul(c2, simd4_set1(bc[2]))),
+			simd4_mul(c3, simd4_set1(bc[3]))
+		);
+	}
+	for (int i = 0; i < 4; i++) {
+		simd4_store(res->cols[i], r[i]);
+	}
+#else
 	res->m[ 0] = b->m[ 0] * a->m[0] + b->m[ 1] * a->m[4] + b->m[ 2] * a->m[ 8] + b->m[ 3] * a->m[12];
 	res->m[ 1] = b->m[ 0] * a->m[1] + b->m[ 1] * a->m[5] + b->m[ 2] * a->m[ 9] + b->m[ 3] * a->m[13];
 	res->m[ 2] = b->m[ 0] * a->m[2] + b->m[ 1] * a->m[6] + b->m[ 2] * a->m[10] + b->m[ 3] * a->m[14];
@@ -140,4 +235,5 @@ void mat4_mul(mat4_t *res, mat4_t *a, mat4_t *b) {
 	res->m[13] = b->m[12] * a->m[1] + b->m[13] * a->m[5] + b->m[14] * a->m[ 9] + b->m[15] * a->m[13];
 	res->m[14] = b->m[12] * a->m[2] + b->m[13] * a->m[6] + b->m[14] * a->m[10] + b->m[15] * a->m[14];
 	res->m[15] = b->m[12] * a->m[3] + b->m[13] * a->m[7] + b->m[14] * a->m[11] + b->m[15] * a->m[15];
+#endif
 }
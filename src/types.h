@@ -56,6 +56,10 @@ typedef struct {
 	vertex_t vertices[3];
 } tris_t;
 
+typedef struct {
+	uint32_t s[4];
+} rand_t;
+
 
 #define rgba(R, G, B, A) ((rgba_t){.r = R, .g = G, .b = B, .a = A})
 #define vec2(X, Y) ((vec2_t){.x = X, .y = Y})
@@ -99,6 +103,13 @@ static inline vec2_t vec2_sub(vec2_t a, vec2_t b) {
 	);
 }
 
+static inline vec2i_t vec2i_add(vec2i_t a, vec2i_t b) {
+	return vec2i(
+		a.x + b.x,
+		a.y + b.y
+	);
+}
+
 static inline vec2i_t vec2i_mulf(vec2i_t a, float f) {
 	return vec2i(
 		a.x * f,
@@ -249,12 +260,14 @@ vec3_t vec3_normalize(vec3_t a);
 vec3_t vec3_project_to_ray(vec3_t p, vec3_t r0, vec3_t r1);
 float vec3_distance_to_plane(vec3_t p, vec3_t plane_pos, vec3_t plane_normal);
 vec3_t vec3_reflect(vec3_t incidence, vec3_t normal, float f);
-vec3_t vec3_rand(float maxlen);
+vec3_t vec3_rand(rand_t *r, float maxlen);
 
 float wrap_angle(float a);
 
 vec3_t vec3_transform(vec3_t a, mat4_t *mat);
 vec4_t vec3_transform_perspective(vec3_t a, mat4_t *mat);
+void vec3_transform_array(const vec3_t *in, vec3_t *out, uint32_t len, mat4_t *mat);
+void vec3_transform_perspective_array(const vec3_t *in, vec4_t *out, uint32_t len, mat4_t *mat);
 vec3_t vec4_perspective_divide(vec4_t a);
 void mat4_set_translation(mat4_t *mat, vec3_t pos);
 void mat4_set_yaw_pitch_roll(mat4_t *m, vec3_t rot);
@@ -2,10 +2,26 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#define FILE_MAP_MMAP
+#endif
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <io.h>
+#endif
 #include "utils.h"
 #include "mem.h"
 
-char temp_path[64];
+static thread_local char temp_path[64];
 char *get_path(const char *dir, const char *file) {
 	strcpy(temp_path, dir);
 	strcpy(temp_path + strlen(dir), file);
@@ -43,26 +59,135 @@ uint8_t *file_load(const char *path, uint32_t *bytes_read) {
 	return bytes;
 }
 
+// The bytes are written to a temporary file first, which then replaces the
+// target. A crash or power loss while writing never leaves a truncated file.
+
 uint32_t file_store(const char *path, void *bytes, int32_t len) {
-	FILE *f = fopen(path, "wb");
-	error_if(!f, "Could not open file for writing: %s", path);
+	char temp_path[1024];
+	error_if(strlen(path) + 4 >= sizeof(temp_path), "Path too long: %s", path);
+	strcat(strcpy(temp_path, path), ".tmp");
+
+	FILE *f = fopen(temp_path, "wb");
+	error_if(!f, "Could not open file for writing: %s", temp_path);
 
 	if (fwrite(bytes, 1, len, f) != len) {
-		die("Could not write file file %s", path);
+		die("Could not write file file %s", temp_path);
 	}
-	
+
+	// Make sure the data is on disk before it replaces the old file
+	fflush(f);
+	#if defined(_WIN32)
+		_commit(_fileno(f));
+	#elif defined(__unix__) || defined(__APPLE__)
+		fsync(fileno(f));
+	#endif
 	fclose(f);
+
+	// rename() doesn't replace existing files on windows; MoveFileEx does so
+	// atomically
+	#if defined(_WIN32)
+		error_if(
+			!MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH),
+			"Could not replace file %s", path
+		);
+	#else
+		error_if(rename(temp_path, path) != 0, "Could not replace file %s", path);
+	#endif
 	return len;
 }
 
+// Maps the whole file read only into memory. Unlike file_load() this does
+// not use the hunk and does not abort if the file is missing. On platforms
+// without mmap() the file is read into a malloc()'d buffer instead.
+
+uint8_t *file_map(const char *path, uint32_t *bytes_read) {
+	#if defined(FILE_MAP_MMAP)
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			return NULL;
+		}
+
+		struct stat s;
+		if (fstat(fd, &s) != 0 || s.st_size <= 0) {
+			close(fd);
+			return NULL;
+		}
+
+		void *bytes = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (bytes == MAP_FAILED) {
+			return NULL;
+		}
+		*bytes_read = s.st_size;
+		return bytes;
+	#else
+		FILE *f = fopen(path, "rb");
+		if (!f) {
+			return NULL;
+		}
+
+		fseek(f, 0, SEEK_END);
+		int32_t size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		uint8_t *bytes = size > 0 ? malloc(size) : NULL;
+		if (!bytes || fread(bytes, 1, size, f) != size) {
+			free(bytes);
+			fclose(f);
+			return NULL;
+		}
+		fclose(f);
+		*bytes_read = size;
+		return bytes;
+	#endif
+}
+
+void file_unmap(uint8_t *bytes, uint32_t len) {
+	#if defined(FILE_MAP_MMAP)
+		munmap(bytes, len);
+	#else
+		(void) len;
+		free(bytes);
+	#endif
+}
+
 bool str_starts_with(const char *haystack, const char *needle) {
 	return (strncmp(haystack, needle, strlen(needle)) == 0);
 }
 
-float rand_float(float min, float max) {
-	return min + ((float)rand() / (float)RAND_MAX) * (max - min);
+void rand_seed(rand_t *r, uint64_t seed) {
+	// Expand the seed with splitmix64, which never yields an all zero state
+	for (int i = 0; i < 4; i += 2) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z = z ^ (z >> 31);
+		r->s[i] = (uint32_t)z;
+		r->s[i + 1] = (uint32_t)(z >> 32);
+	}
+}
+
+static inline uint32_t rand_rotl(uint32_t x, int k) {
+	return (x << k) | (x >> (32 - k));
+}
+
+uint32_t rand_next(rand_t *r) {
+	uint32_t *s = r->s;
+	uint32_t result = rand_rotl(s[1] * 5, 7) * 9;
+	uint32_t t = s[1] << 9;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rand_rotl(s[3], 11);
+	return result;
+}
+
+float rand_float(rand_t *r, float min, float max) {
+	return min + (rand_next(r) >> 8) * (1.0f / 16777216.0f) * (max - min);
 }
 
-int32_t rand_int(int32_t min, int32_t max) {
-	return min + rand() % (max - min);
+int32_t rand_int(rand_t *r, int32_t min, int32_t max) {
+	// Scale into [0, max - min) with a multiply instead of a modulo
+	return min + (int32_t)(((uint64_t)rand_next(r) * (uint32_t)(max - min)) >> 32);
 }
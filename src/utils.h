@@ -16,6 +16,10 @@
 #endif
 #define member_size(type, member) sizeof(((type *)0)->member)
 
+#if !defined(thread_local)
+	#define thread_local _Thread_local
+#endif
+
 #define max(a,b) ({ \
 		__typeof__ (a) _a = (a); \
 		__typeof__ (b) _b = (b); \
@@ -75,12 +79,20 @@
 
 char *get_path(const char *dir, const char *file);
 bool str_starts_with(const char *haystack, const char *needle);
-float rand_float(float min, float max);
-int32_t rand_int(int32_t min, int32_t max); 
+
+// Random number streams with explicit state (xoshiro128**, see rand_t). Each
+// stream is independent, so e.g. cosmetic effects never change what the
+// simulation draws and every thread can have its own stream.
+void rand_seed(rand_t *r, uint64_t seed);
+uint32_t rand_next(rand_t *r);
+float rand_float(rand_t *r, float min, float max);
+int32_t rand_int(rand_t *r, int32_t min, int32_t max);
 
 bool file_exists(const char *path);
 uint8_t *file_load(const char *path, uint32_t *bytes_read);
 uint32_t file_store(const char *path, void *bytes, int32_t len);
+uint8_t *file_map(const char *path, uint32_t *bytes_read);
+void file_unmap(uint8_t *bytes, uint32_t len);
 
 
 #define sort(LIST, LEN, COMPARE_FUNC) \
@@ -94,9 +106,9 @@ uint32_t file_store(const char *path, void *bytes, int32_t len);
 		(LIST)[sort_j] = sort_temp; \
 	}
 
-#define shuffle(LIST, LEN) \
+#define shuffle(RAND, LIST, LEN) \
 	for (int i = (LEN) - 1; i > 0; i--) { \
-		int j = rand_int(0, i+1); \
+		int j = rand_int(RAND, 0, i+1); \
 		swap((LIST)[i], (LIST)[j]); \
 	}
 
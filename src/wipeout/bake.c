@@ -0,0 +1,318 @@
+#include "../mem.h"
+#include "../utils.h"
+#include "../platform.h"
+#include "../jobs.h"
+
+#include "bake.h"
+
+#define BAKE_NAME_MAX 128
+#define BAKE_ASSET_NAME_MAX 64
+
+typedef struct {
+	uint32_t name_hash;
+	uint32_t type;
+	uint32_t source_hash;
+	uint32_t len;
+	uint8_t *bytes;
+	uint32_t last_used;
+	uint32_t in_use;
+} bake_cache_entry_t;
+
+typedef struct {
+	char name[BAKE_ASSET_NAME_MAX];
+	uint32_t hash;
+} bake_asset_hash_t;
+
+// The cache and the asset hashes are shared with the background loader and
+// guarded by jobs_lock(). Cache slots are never moved, so an open bake can
+// keep its slot index; free slots have no bytes.
+static bake_cache_entry_t cache[BAKE_CACHE_ENTRIES_MAX];
+static uint32_t cache_len = 0;
+static uint32_t cache_bytes = 0;
+static uint32_t cache_tick = 0;
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+
+static bake_asset_hash_t asset_hashes[BAKE_ASSET_HASHES_MAX];
+static uint32_t asset_hashes_len = 0;
+
+static void bake_cache_insert(const char *name, bake_type_t type, uint32_t source_hash, uint8_t *bytes, uint32_t len);
+
+static char *bake_name(const char *name) {
+	static thread_local char bake_name_buffer[BAKE_NAME_MAX];
+	error_if(strlen(name) + 6 >= BAKE_NAME_MAX, "Bake name too long: %s", name);
+
+	// Flatten the asset path into a single file name in the userdata dir
+	strcpy(bake_name_buffer, "bake_");
+	char *dst = bake_name_buffer + 5;
+	for (const char *src = name; *src; src++) {
+		*(dst++) = (*src == '/' || *src == '\\') ? '_' : *src;
+	}
+	*dst = '\0';
+	return bake_name_buffer;
+}
+
+// FNV-1a; chain calls to hash multiple source files into one value
+uint32_t bake_hash(uint32_t hash, const void *bytes, uint32_t len) {
+	const uint8_t *b = bytes;
+	for (uint32_t i = 0; i < len; i++) {
+		hash = (hash ^ b[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// The content hash of each asset file is computed once and then remembered
+// by path; assets are not modified while the game is running.
+
+static bool bake_find_asset_hash(const char *name, uint32_t *file_hash) {
+	for (uint32_t i = 0; i < asset_hashes_len; i++) {
+		if (strcmp(asset_hashes[i].name, name) == 0) {
+			*file_hash = asset_hashes[i].hash;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t bake_hash_asset(uint32_t hash, const char *name) {
+	uint32_t file_hash;
+	jobs_lock();
+	bool found = bake_find_asset_hash(name, &file_hash);
+	jobs_unlock();
+	if (found) {
+		return bake_hash(hash, &file_hash, sizeof(uint32_t));
+	}
+
+	uint32_t len;
+	uint8_t *bytes = platform_map_asset(name, &len);
+	file_hash = bake_hash(BAKE_HASH_INIT, &len, sizeof(len));
+	file_hash = bake_hash(file_hash, bytes, len);
+	platform_unmap_asset(bytes, len);
+
+	jobs_lock();
+	uint32_t known_hash;
+	if (
+		!bake_find_asset_hash(name, &known_hash) &&
+		asset_hashes_len < BAKE_ASSET_HASHES_MAX &&
+		strlen(name) < BAKE_ASSET_NAME_MAX
+	) {
+		bake_asset_hash_t *ah = &asset_hashes[asset_hashes_len++];
+		strcpy(ah->name, name);
+		ah->hash = file_hash;
+	}
+	jobs_unlock();
+	return bake_hash(hash, &file_hash, sizeof(uint32_t));
+}
+
+static int32_t bake_cache_find(const char *name, bake_type_t type, uint32_t source_hash) {
+	uint32_t name_hash = bake_hash(BAKE_HASH_INIT, name, strlen(name));
+	for (uint32_t i = 0; i < BAKE_CACHE_ENTRIES_MAX; i++) {
+		if (
+			cache[i].bytes &&
+			cache[i].name_hash == name_hash &&
+			cache[i].type == type &&
+			cache[i].source_hash == source_hash
+		) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Makes room for len bytes by evicting the least recently used entries that
+// are not currently open.
+static bool bake_cache_evict(uint32_t len) {
+	while (cache_bytes + len > BAKE_CACHE_BYTES || cache_len >= BAKE_CACHE_ENTRIES_MAX) {
+		int32_t lru = -1;
+		for (uint32_t i = 0; i < BAKE_CACHE_ENTRIES_MAX; i++) {
+			if (
+				cache[i].bytes && cache[i].in_use == 0 &&
+				(lru == -1 || cache[i].last_used < cache[lru].last_used)
+			) {
+				lru = i;
+			}
+		}
+		if (lru == -1) {
+			return false;
+		}
+		cache_bytes -= cache[lru].len;
+		cache_len--;
+		free(cache[lru].bytes);
+		cache[lru] = (bake_cache_entry_t){0};
+	}
+	return true;
+}
+
+static void bake_cache_insert(const char *name, bake_type_t type, uint32_t source_hash, uint8_t *bytes, uint32_t len) {
+	if (len > BAKE_CACHE_BYTES) {
+		return;
+	}
+
+	// Copy outside of the lock; the copy is dropped if another thread
+	// inserted the same bake in the meantime
+	uint8_t *copy = malloc(len);
+	if (!copy) {
+		return;
+	}
+	memcpy(copy, bytes, len);
+
+	jobs_lock();
+	if (bake_cache_find(name, type, source_hash) != -1 || !bake_cache_evict(len)) {
+		jobs_unlock();
+		free(copy);
+		return;
+	}
+
+	int32_t slot = 0;
+	while (cache[slot].bytes) {
+		slot++;
+	}
+	cache_len++;
+	cache[slot] = (bake_cache_entry_t){
+		.name_hash = bake_hash(BAKE_HASH_INIT, name, strlen(name)),
+		.type = type,
+		.source_hash = source_hash,
+		.len = len,
+		.bytes = copy,
+		.last_used = cache_tick++
+	};
+	cache_bytes += len;
+	jobs_unlock();
+}
+
+void bake_cache_dump(void) {
+	jobs_lock();
+	printf(
+		"bake cache: %d entries, %.1f/%.1f MB, %d hits, %d misses\n",
+		cache_len, cache_bytes / (1024.0 * 1024.0), BAKE_CACHE_BYTES / (1024.0 * 1024.0),
+		cache_hits, cache_misses
+	);
+	jobs_unlock();
+}
+
+bool bake_open(bake_t *bake, const char *name, bake_type_t type, uint32_t source_hash) {
+	bake->p = sizeof(bake_header_t);
+	jobs_lock();
+	bake->cache_index = bake_cache_find(name, type, source_hash);
+	if (bake->cache_index != -1) {
+		bake_cache_entry_t *entry = &cache[bake->cache_index];
+		entry->in_use++;
+		entry->last_used = cache_tick++;
+		bake->bytes = entry->bytes;
+		bake->len = entry->len;
+		cache_hits++;
+		jobs_unlock();
+		printf("load bake (cached): %s\n", name);
+		return true;
+	}
+	cache_misses++;
+	jobs_unlock();
+
+	bake->p = 0;
+	bake->bytes = platform_map_userdata(bake_name(name), &bake->len);
+	if (!bake->bytes) {
+		return false;
+	}
+
+	bake_header_t *header = (bake_header_t *)bake->bytes;
+	if (
+		bake->len < sizeof(bake_header_t) ||
+		header->magic != BAKE_MAGIC ||
+		header->version != BAKE_VERSION ||
+		header->type != type ||
+		header->source_hash != source_hash ||
+		header->data_len != bake->len - sizeof(bake_header_t)
+	) {
+		printf("bake for %s is stale\n", name);
+		bake_close(bake);
+		return false;
+	}
+
+	printf("load bake: %s\n", name);
+	bake->p = sizeof(bake_header_t);
+	bake_cache_insert(name, type, source_hash, bake->bytes, bake->len);
+	return true;
+}
+
+// Returns a pointer into the mapped bake file; the data is read only. All 
+// chunks are padded to 8 bytes, so the returned pointers are aligned.
+void *bake_read(bake_t *bake, uint32_t len) {
+	error_if(bake->p + len > bake->len, "Read beyond end of bake file");
+	void *p = bake->bytes + bake->p;
+	bake->p += round_up_to_word(len);
+	return p;
+}
+
+void bake_close(bake_t *bake) {
+	if (bake->cache_index != -1) {
+		jobs_lock();
+		cache[bake->cache_index].in_use--;
+		jobs_unlock();
+	}
+	else if (bake->bytes) {
+		platform_unmap_userdata(bake->bytes, bake->len);
+	}
+	bake->cache_index = -1;
+	bake->bytes = NULL;
+	bake->len = 0;
+	bake->p = 0;
+}
+
+// The header is written with an invalid magic first and only completed in
+// bake_finish(), so an aborted bake is never considered valid.
+
+FILE *bake_create(const char *name, bake_type_t type, uint32_t source_hash) {
+	FILE *file = platform_open_userdata(bake_name(name), "wb");
+	if (!file) {
+		printf("Could not create bake file for %s\n", name);
+		return NULL;
+	}
+
+	bake_header_t header = {.magic = 0, .version = BAKE_VERSION, .type = type, .source_hash = source_hash};
+	fwrite(&header, sizeof(header), 1, file);
+	return file;
+}
+
+void bake_write(FILE *file, const void *bytes, uint32_t len) {
+	if (!file) {
+		return;
+	}
+	static const uint8_t padding[8] = {0};
+	fwrite(bytes, 1, len, file);
+	fwrite(padding, 1, round_up_to_word(len) - len, file);
+}
+
+void bake_finish(FILE *file, const char *name, bake_type_t type, uint32_t source_hash) {
+	if (!file) {
+		return;
+	}
+
+	if (ferror(file)) {
+		printf("Could not write bake file\n");
+		fclose(file);
+		return;
+	}
+
+	long len = ftell(file);
+	bake_header_t header = {
+		.magic = BAKE_MAGIC,
+		.version = BAKE_VERSION,
+		.type = type,
+		.source_hash = source_hash,
+		.data_len = len - sizeof(bake_header_t)
+	};
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+	fclose(file);
+
+	// Read the fresh bake back into the cache, so that the next visit of this
+	// scene doesn't need the disk
+	uint32_t bytes_len;
+	uint8_t *bytes = platform_map_userdata(bake_name(name), &bytes_len);
+	if (bytes) {
+		if (bytes_len == (uint32_t)len) {
+			bake_cache_insert(name, type, source_hash, bytes, bytes_len);
+		}
+		platform_unmap_userdata(bytes, bytes_len);
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef BAKE_H
+#define BAKE_H
+
+#include "../types.h"
+
+// Baked assets hold the decoded and parsed form of the original game files in
+// native layout. They are generated the first time an asset is loaded and
+// stored in the userdata directory. Subsequent loads memory map the bake file
+// instead of decompressing and parsing the original data again.
+
+// Bakes are also kept in memory, outside of the hunk, up to BAKE_CACHE_BYTES.
+// The hunk and the texture atlas are still reset on every scene change, but
+// revisiting a scene restores its assets from the cache without touching the
+// disk. The least recently used bakes are evicted when the budget is full.
+// Asset files don't change while the game runs, so their content hash is
+// computed only once per path.
+
+#define BAKE_MAGIC 0x656b6162 // "bake"
+#define BAKE_VERSION 1
+#define BAKE_HASH_INIT 2166136261u
+
+#ifndef BAKE_CACHE_BYTES
+	#define BAKE_CACHE_BYTES (96 * 1024 * 1024)
+#endif
+#define BAKE_CACHE_ENTRIES_MAX 128
+#define BAKE_ASSET_HASHES_MAX 256
+
+typedef enum {
+	BAKE_TYPE_TEXTURES,
+	BAKE_TYPE_TRACK_FACES,
+	BAKE_TYPE_OBJECTS,
+} bake_type_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t type;
+	uint32_t source_hash;
+	uint32_t data_len;
+	uint32_t pad;
+} bake_header_t;
+
+typedef struct {
+	uint8_t *bytes;
+	uint32_t len;
+	uint32_t p;
+	int32_t cache_index;
+} bake_t;
+
+uint32_t bake_hash(uint32_t hash, const void *bytes, uint32_t len);
+uint32_t bake_hash_asset(uint32_t hash, const char *name);
+
+bool bake_open(bake_t *bake, const char *name, bake_type_t type, uint32_t source_hash);
+void *bake_read(bake_t *bake, uint32_t len);
+void bake_close(bake_t *bake);
+
+FILE *bake_create(const char *name, bake_type_t type, uint32_t source_hash);
+void bake_write(FILE *file, const void *bytes, uint32_t len);
+void bake_finish(FILE *file, const char *name, bake_type_t type, uint32_t source_hash);
+
+void bake_cache_dump(void);
+
+#endif
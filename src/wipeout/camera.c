@@ -155,7 +155,7 @@ void camera_update_static_follow(camera_t *camera, ship_t *ship, droid_t *droid)
 void camera_update_attract_random(camera_t *camera, ship_t *ship, droid_t *droid) {
 	flags_rm(ship->flags, SHIP_VIEW_INTERNAL);
 
-	if (rand() % 2) {
+	if (rand_int(&g.rand_fx, 0, 2)) {
 		camera->update_func = camera_update_attract_circle;
 		camera->update_timer = 5;
 	}
@@ -182,8 +182,8 @@ void camera_set_shake(camera_t *camera, float duration) {
 void camera_update_shake(camera_t *camera) {
 	if (camera->shake_timer > 0.0f) {
 		float s = 0.25 * save.screen_shake * camera->shake_timer;
-		camera->shake.x = rand_float(-s, s);
-		camera->shake.y = rand_float(-s, s);
+		camera->shake.x = rand_float(&g.rand_fx, -s, s);
+		camera->shake.y = rand_float(&g.rand_fx, -s, s);
 		camera->shake_timer -= system_tick();
 	}
 	else {
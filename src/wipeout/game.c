@@ -5,6 +5,9 @@
 #include "../system.h"
 #include "../platform.h"
 #include "../input.h"
+#include "../jobs.h"
+#include "../profile.h"
+#include "../replay.h"
 
 #include "game.h"
 #include "ship.h"
@@ -20,6 +23,7 @@
 #include "main_menu.h"
 #include "title.h"
 #include "intro.h"
+#include "bake.h"
 
 #define TURN_ACCEL(V) NTSC_ACCELERATION(ANGLE_NORM_TO_RADIAN(FIXED_TO_FLOAT(YAW_VELOCITY(V))))
 #define TURN_VEL(V)   NTSC_VELOCITY(ANGLE_NORM_TO_RADIAN(FIXED_TO_FLOAT(YAW_VELOCITY(V))))
@@ -813,19 +817,21 @@ game_t g = {0};
 
 
 struct {
+	const char *name;
 	void (*init)(void);
 	void (*update)(void);
 } game_scenes[] = {
-	[GAME_SCENE_INTRO] = {intro_init, intro_update},
-	[GAME_SCENE_TITLE] = {title_init, title_update},
-	[GAME_SCENE_MAIN_MENU] = {main_menu_init, main_menu_update},
-	[GAME_SCENE_RACE] = {race_init, race_update},
+	[GAME_SCENE_INTRO] = {"intro", intro_init, intro_update},
+	[GAME_SCENE_TITLE] = {"title", title_init, title_update},
+	[GAME_SCENE_MAIN_MENU] = {"main menu", main_menu_init, main_menu_update},
+	[GAME_SCENE_RACE] = {"race", race_init, race_update},
 };
 
 static game_scene_t scene_current = GAME_SCENE_NONE;
 static game_scene_t scene_next = GAME_SCENE_NONE;
 static int global_textures_len = 0;
 static void *global_mem_mark = 0;
+static save_t save_written;
 
 void game_init(void) {
 	error_if(!file_exists("wipeout/track01/"), "Wipeout game content missing. Check your wipeout/ directory.\n");
@@ -859,21 +865,35 @@ void game_init(void) {
 	render_set_resolution(save.screen_res);
 	render_set_post_effect(save.post_effect);
 
-	srand((int)(platform_now() * 100));
+	// Different seeds give independent streams
+	rand_seed(&g.rand_sim, replay_seed());
+	rand_seed(&g.rand_fx, (uint64_t)replay_seed() << 32 | 1);
 	
+	if (getenv("WIPEOUT_CMP_CHECK")) {
+		image_check_compressed();
+	}
+
+	mem_set_tag(MEM_TAG_UI);
 	ui_load();
+	mem_set_tag(MEM_TAG_SFX);
 	sfx_load();
+	mem_set_tag(MEM_TAG_UI);
 	hud_load();
+	mem_set_tag(MEM_TAG_OBJECTS);
 	ships_load();
 	droid_load();
+	mem_set_tag(MEM_TAG_PARTICLES);
 	particles_load();
+	mem_set_tag(MEM_TAG_WEAPONS);
 	weapons_load();
+	mem_set_tag(MEM_TAG_NONE);
 
 	global_textures_len = render_textures_len();
 	global_mem_mark = mem_mark();
+	mem_dump("global");
 
 	sfx_music_mode(SFX_MUSIC_PAUSED);
-	sfx_music_play(rand_int(0, len(def.music)));
+	sfx_music_play(rand_int(&g.rand_fx, 0, len(def.music)));
 
 
 	// System binds; always fixed
@@ -933,6 +953,21 @@ void game_init(void) {
 	game_set_scene(GAME_SCENE_INTRO);
 }
 
+static void game_store_save(void *data) {
+	platform_store_userdata("save.dat", data, sizeof(save_t));
+	printf("wrote save.dat\n");
+}
+
+// Finishes a running save and writes any changes that are still pending
+void game_cleanup(void) {
+	sfx_cleanup();
+	jobs_background_wait(JOBS_BACKGROUND_SAVE);
+	if (save.is_dirty) {
+		save.is_dirty = false;
+		game_store_save(&save);
+	}
+}
+
 void game_set_scene(game_scene_t scene) {
 	sfx_reset();
 	scene_next = scene;
@@ -947,6 +982,7 @@ void game_reset_championship(void) {
 }
 
 void game_update(void) {
+	PROFILE_BEGIN("game_update");
 	double frame_start_time = platform_now();
 
 	int sh = render_size().y;
@@ -958,6 +994,10 @@ void game_update(void) {
 
 
 	if (scene_next != GAME_SCENE_NONE) {
+		// Report the high water mark of the scene we are about to release
+		if (scene_current != GAME_SCENE_NONE) {
+			mem_dump(game_scenes[scene_current].name);
+		}
 		scene_current = scene_next;
 		scene_next = GAME_SCENE_NONE;
 		render_textures_reset(global_textures_len);
@@ -966,12 +1006,16 @@ void game_update(void) {
 
 		if (scene_current != GAME_SCENE_NONE) {
 			game_scenes[scene_current].init();
+			bake_cache_dump();
 		}
 	}
 
 	if (scene_current != GAME_SCENE_NONE) {
+		PROFILE_BEGIN(game_scenes[scene_current].name);
 		game_scenes[scene_current].update();
+		PROFILE_END(game_scenes[scene_current].name);
 	}
+	sfx_update();
 
 	// Fullscreen might have been toggled through alt+enter
 	bool fullscreen = platform_get_fullscreen();
@@ -980,12 +1024,16 @@ void game_update(void) {
 		save.is_dirty = true;
 	}
 
-	if (save.is_dirty) {
+	// The save data is written on a background thread from a copy. Changes
+	// that happen while a write is still running are coalesced into one
+	// write after it.
+	if (save.is_dirty && !jobs_background_busy(JOBS_BACKGROUND_SAVE)) {
 		// FIXME: use a text based format?
-		// FIXME: this should probably run async somewhere
 		save.is_dirty = false;
-		platform_store_userdata("save.dat", &save, sizeof(save_t));
-		printf("wrote save.dat\n");
+		save_written = save;
+		if (!jobs_background_start(JOBS_BACKGROUND_SAVE, game_store_save, &save_written)) {
+			game_store_save(&save_written);
+		}
 	}
 
 	double now = platform_now();
@@ -994,6 +1042,8 @@ void game_update(void) {
 		g.frame_rate = ((double)g.frame_rate * 0.95) + (1.0/g.frame_time) * 0.05;
 	}
 	
+	PROFILE_END("game_update");
+
 	// The only drawing left here should be the post process
 }
 
@@ -253,6 +253,11 @@ typedef struct {
 
 	bool additional_circuts;
 	bool installed_circuts[NUM_CIRCUTS];
+
+	// Random streams for everything that affects the race and for purely
+	// cosmetic effects (particles, exhaust, camera, music)
+	rand_t rand_sim;
+	rand_t rand_fx;
 } game_t;
 
 
@@ -301,6 +306,7 @@ extern game_t g;
 extern save_t save;
 
 void game_init(void);
+void game_cleanup(void);
 void game_set_scene(game_scene_t scene);
 void game_reset_championship(void);
 void game_update(void);
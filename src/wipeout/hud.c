@@ -50,6 +50,64 @@ const struct {
 
 static uint16_t speedo_facia_texture;
 
+// Parts of the hud that rarely change are kept in retained render layers and
+// only drawn again when the values they show change.
+typedef enum {
+	HUD_LAYER_LAP,
+	HUD_LAYER_POSITION,
+	HUD_LAYER_SPEEDO,
+	NUM_HUD_LAYERS
+} hud_layer_t;
+
+static struct {
+	bool valid;
+	uint32_t key;
+	vec2i_t size;
+} hud_layers[NUM_HUD_LAYERS];
+static bool hud_layer_active;
+
+static uint32_t hud_layer_key(int a, int b, int c) {
+	uint32_t key = 2166136261u;
+	key = (key ^ (uint32_t)ui_get_scale()) * 16777619u;
+	key = (key ^ (uint32_t)a) * 16777619u;
+	key = (key ^ (uint32_t)b) * 16777619u;
+	key = (key ^ (uint32_t)c) * 16777619u;
+	return key;
+}
+
+// Returns true if the contents of the layer have to be drawn, relative to
+// origin, followed by hud_layer_end(). Otherwise the retained layer was
+// already composited at pos.
+static bool hud_layer_begin(hud_layer_t layer, uint32_t key, vec2i_t pos, vec2i_t size, vec2i_t *origin) {
+	if (
+		hud_layers[layer].valid && hud_layers[layer].key == key &&
+		hud_layers[layer].size.x == size.x && hud_layers[layer].size.y == size.y
+	) {
+		render_layer_draw(layer, pos);
+		return false;
+	}
+
+	hud_layer_active = render_layer_begin(layer, size);
+	if (hud_layer_active) {
+		hud_layers[layer].valid = true;
+		hud_layers[layer].key = key;
+		hud_layers[layer].size = size;
+		*origin = vec2i(0, 0);
+	}
+	else {
+		*origin = pos;
+	}
+	return true;
+}
+
+static void hud_layer_end(hud_layer_t layer, vec2i_t pos) {
+	if (hud_layer_active) {
+		render_layer_end();
+		render_layer_draw(layer, pos);
+		hud_layer_active = false;
+	}
+}
+
 void hud_load(void) {
 	speedo_facia_texture = image_get_texture("wipeout/textures/speedo.tim");
 	target_reticle = image_get_texture_semi_trans("wipeout/textures/target2.tim");
@@ -159,10 +217,19 @@ static void hud_draw_speedo_bars(vec2i_t *pos, float f, rgba_t color_override) {
 
 static void hud_draw_speedo(int speed, int thrust) {
 	vec2i_t facia_pos = ui_scaled_pos(UI_POS_BOTTOM | UI_POS_RIGHT, vec2i(-141, -45));
-	vec2i_t bar_pos = ui_scaled_pos(UI_POS_BOTTOM | UI_POS_RIGHT, vec2i(-141, -40));
+	vec2i_t facia_size = ui_scaled(render_texture_size(speedo_facia_texture));
+
+	// The bars change nearly every frame and are drawn directly; only the
+	// facia on top of them is retained
+	vec2i_t bar_pos = vec2i_add(facia_pos, ui_scaled(vec2i(0, 5)));
 	hud_draw_speedo_bars(&bar_pos, thrust / 65.0, rgba(255, 0, 0, 128));
 	hud_draw_speedo_bars(&bar_pos, speed / 2166.0, rgba(0, 0, 0, 0));
-	render_push_2d(facia_pos, ui_scaled(render_texture_size(speedo_facia_texture)), rgba(128, 128, 128, 255), speedo_facia_texture);
+
+	vec2i_t origin;
+	if (hud_layer_begin(HUD_LAYER_SPEEDO, hud_layer_key(0, 0, 0), facia_pos, facia_size, &origin)) {
+		render_push_2d(origin, facia_size, rgba(128, 128, 128, 255), speedo_facia_texture);
+		hud_layer_end(HUD_LAYER_SPEEDO, facia_pos);
+	}
 }
 
 static void hud_draw_target_icon(vec3_t position) {
@@ -196,18 +263,30 @@ void hud_draw(ship_t *ship) {
 		}
 	}
 
-	// Current Lap
+	// Current Lap and Lap Record
 	int display_lap = max(0, ship->lap + 1);
-	ui_draw_text("LAP", ui_scaled(vec2i(15, 8)), UI_SIZE_8, UI_COLOR_ACCENT); 
-	ui_draw_number(display_lap, ui_scaled(vec2i(10, 19)), UI_SIZE_16, UI_COLOR_DEFAULT); 
-	int width = ui_char_width('0' + display_lap, UI_SIZE_16);
-	ui_draw_text("OF", ui_scaled(vec2i((10 + width), 27)), UI_SIZE_8, UI_COLOR_ACCENT);
-	ui_draw_number(NUM_LAPS, ui_scaled(vec2i((32 + width), 19)), UI_SIZE_16, UI_COLOR_DEFAULT);
+	float lap_record = save.highscores[g.race_class][g.circut][g.highscore_tab].lap_record;
+	vec2i_t origin;
+	if (hud_layer_begin(HUD_LAYER_LAP, hud_layer_key(display_lap, lap_record * 1000, 0), vec2i(0, 0), ui_scaled(vec2i(128, 64)), &origin)) {
+		ui_draw_text("LAP", vec2i_add(origin, ui_scaled(vec2i(15, 8))), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_number(display_lap, vec2i_add(origin, ui_scaled(vec2i(10, 19))), UI_SIZE_16, UI_COLOR_DEFAULT);
+		int width = ui_char_width('0' + display_lap, UI_SIZE_16);
+		ui_draw_text("OF", vec2i_add(origin, ui_scaled(vec2i((10 + width), 27))), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_number(NUM_LAPS, vec2i_add(origin, ui_scaled(vec2i((32 + width), 19))), UI_SIZE_16, UI_COLOR_DEFAULT);
+
+		ui_draw_text("LAP RECORD", vec2i_add(origin, ui_scaled(vec2i(15, 43))), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_time(lap_record, vec2i_add(origin, ui_scaled(vec2i(15, 55))), UI_SIZE_8, UI_COLOR_DEFAULT);
+		hud_layer_end(HUD_LAYER_LAP, vec2i(0, 0));
+	}
 
 	// Race Position
 	if (g.race_type != RACE_TYPE_TIME_TRIAL) {
-		ui_draw_text("POSITION", ui_scaled_pos(UI_POS_TOP | UI_POS_RIGHT, vec2i(-90, 8)), UI_SIZE_8, UI_COLOR_ACCENT);
-		ui_draw_number(ship->position_rank, ui_scaled_pos(UI_POS_TOP | UI_POS_RIGHT, vec2i(-60, 19)), UI_SIZE_16, UI_COLOR_DEFAULT);
+		vec2i_t pos = ui_scaled_pos(UI_POS_TOP | UI_POS_RIGHT, vec2i(-90, 8));
+		if (hud_layer_begin(HUD_LAYER_POSITION, hud_layer_key(ship->position_rank, 0, 0), pos, ui_scaled(vec2i(90, 28)), &origin)) {
+			ui_draw_text("POSITION", origin, UI_SIZE_8, UI_COLOR_ACCENT);
+			ui_draw_number(ship->position_rank, vec2i_add(origin, ui_scaled(vec2i(30, 11))), UI_SIZE_16, UI_COLOR_DEFAULT);
+			hud_layer_end(HUD_LAYER_POSITION, pos);
+		}
 	}
 
 	// Framerate/draw stats
@@ -224,16 +303,33 @@ void hud_draw(ship_t *ship) {
 		ui_draw_number((int)(stats->num_tris), ui_scaled(vec2i(16, 90)), UI_SIZE_8, UI_COLOR_DEFAULT);
 		ui_draw_number((int)(stats->num_draw_calls), ui_scaled(vec2i(80, 90)), UI_SIZE_8, UI_COLOR_DEFAULT);
 		ui_draw_number((int)(g.frame_time * 1000), ui_scaled(vec2i(144, 90)), UI_SIZE_8, UI_COLOR_DEFAULT);
+
+		uint32_t state_changes = 0;
+		for (int i = 0; i < NUM_RENDER_FLUSH_CAUSES; i++) {
+			state_changes += stats->num_state_changes[i];
+		}
+		ui_draw_text("STATES", ui_scaled(vec2i(16, 102)), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_text("VTX KB", ui_scaled(vec2i(80, 102)), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_text("FLUSH US", ui_scaled(vec2i(144, 102)), UI_SIZE_8, UI_COLOR_ACCENT);
+		ui_draw_number((int)(state_changes), ui_scaled(vec2i(16, 114)), UI_SIZE_8, UI_COLOR_DEFAULT);
+		ui_draw_number((int)(stats->num_vertex_bytes / 1024), ui_scaled(vec2i(80, 114)), UI_SIZE_8, UI_COLOR_DEFAULT);
+		ui_draw_number((int)(stats->flush_time * 1000000), ui_scaled(vec2i(144, 114)), UI_SIZE_8, UI_COLOR_DEFAULT);
+
+		// Culling and fill are only known to the software renderer
+		if (stats->num_pixels > 0) {
+			ui_draw_text("CULLED", ui_scaled(vec2i(16, 126)), UI_SIZE_8, UI_COLOR_ACCENT);
+			ui_draw_text("CLIPPED", ui_scaled(vec2i(80, 126)), UI_SIZE_8, UI_COLOR_ACCENT);
+			ui_draw_text("PIXELS K", ui_scaled(vec2i(144, 126)), UI_SIZE_8, UI_COLOR_ACCENT);
+			ui_draw_number((int)(stats->num_tris_culled), ui_scaled(vec2i(16, 138)), UI_SIZE_8, UI_COLOR_DEFAULT);
+			ui_draw_number((int)(stats->num_tris_clipped), ui_scaled(vec2i(80, 138)), UI_SIZE_8, UI_COLOR_DEFAULT);
+			ui_draw_number((int)(stats->num_pixels / 1000), ui_scaled(vec2i(144, 138)), UI_SIZE_8, UI_COLOR_DEFAULT);
+		}
 		break;
 	}
 	default:
 		break;
 	}
 
-	// Lap Record
-	ui_draw_text("LAP RECORD", ui_scaled(vec2i(15, 43)), UI_SIZE_8, UI_COLOR_ACCENT);
-	ui_draw_time(save.highscores[g.race_class][g.circut][g.highscore_tab].lap_record, ui_scaled(vec2i(15, 55)), UI_SIZE_8, UI_COLOR_DEFAULT);
-
 	// Wrong way
 	if (flags_not(ship->flags, SHIP_DIRECTION_FORWARD)) {
 		ui_draw_text_centered("WRONG WAY", ui_scaled_pos(UI_POS_MIDDLE | UI_POS_CENTER, vec2i(-20, 0)), UI_SIZE_16, UI_COLOR_ACCENT);
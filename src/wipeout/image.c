@@ -2,6 +2,7 @@
 #include "../mem.h"
 #include "../utils.h"
 #include "../platform.h"
+#include "../jobs.h"
 
 #include "object.h"
 #include "track.h"
@@ -14,6 +15,7 @@
 #include "game.h"
 #include "hud.h"
 #include "image.h"
+#include "bake.h"
 
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -44,7 +46,40 @@ image_t *image_alloc(uint32_t width, uint32_t height) {
 	return image;
 }
 
-image_t *image_load_from_bytes(uint8_t *bytes, bool transparent) {
+// TIM images are decoded in two steps, so that the pixels can be allocated
+// up front and several images can be decoded in parallel: image_tim_size()
+// only reads the header, image_decode_tim() writes the pixels into an
+// existing image at dx, dy, dropping everything outside of the w * h rect.
+
+void image_tim_size(uint8_t *bytes, uint32_t *width, uint32_t *height) {
+	uint32_t p = 4;
+	uint32_t type = get_i32_le(bytes, &p) & 0xF;
+
+	if (
+		type == TIM_TYPE_PALETTED_4_BPP ||
+		type == TIM_TYPE_PALETTED_8_BPP
+	) {
+		p += 4 + 2 + 2;
+		uint16_t palette_colors = get_i16_le(bytes, &p);
+		p += 2 + palette_colors * 2;
+	}
+
+	int32_t pixels_per_16bit = 1;
+	if (type == TIM_TYPE_PALETTED_8_BPP) {
+		pixels_per_16bit = 2;
+	}
+	else if (type == TIM_TYPE_PALETTED_4_BPP) {
+		pixels_per_16bit = 4;
+	}
+
+	p += 4 + 2 + 2;
+	uint16_t entries_per_row = get_i16_le(bytes, &p);
+	uint16_t rows = get_i16_le(bytes, &p);
+	*width = entries_per_row * pixels_per_16bit;
+	*height = rows;
+}
+
+void image_decode_tim(uint8_t *bytes, bool transparent, image_t *dst, uint32_t dx, uint32_t dy, uint32_t w, uint32_t h) {
 	uint32_t p = 0;
 
 	uint32_t magic = get_i32_le(bytes, &p);
@@ -70,7 +105,7 @@ image_t *image_load_from_bytes(uint8_t *bytes, bool transparent) {
 
 	uint32_t data_size = get_i32_le(bytes, &p);
 
-	int32_t pixels_per_16bit = 1;
+	uint32_t pixels_per_16bit = 1;
 	if (type == TIM_TYPE_PALETTED_8_BPP) {
 		pixels_per_16bit = 2;
 	}
@@ -83,35 +118,36 @@ image_t *image_load_from_bytes(uint8_t *bytes, bool transparent) {
 	uint16_t entries_per_row  = get_i16_le(bytes, &p);
 	uint16_t rows = get_i16_le(bytes, &p);
 
-	int32_t width = entries_per_row * pixels_per_16bit;
-	int32_t height = rows;
-	int32_t entries = entries_per_row * rows;
+	uint32_t width = min(entries_per_row * pixels_per_16bit, w);
+	uint32_t height = min(rows, h);
 
-	image_t *image = image_alloc(width, height);
-	int32_t pixel_pos = 0;
+	for (uint32_t y = 0; y < height; y++) {
+		rgba_t *out = dst->pixels + (dy + y) * dst->width + dx;
+		uint8_t *in = bytes + p + y * entries_per_row * 2;
 
-	if (type == TIM_TYPE_TRUE_COLOR_16_BPP) {
-		for (int i = 0; i < entries; i++) {
-			image->pixels[pixel_pos++] = tim_16bit_to_rgba(get_u16_le(bytes, &p), transparent);
+		if (type == TIM_TYPE_TRUE_COLOR_16_BPP) {
+			for (uint32_t x = 0; x < width; x++) {
+				out[x] = tim_16bit_to_rgba(in[x * 2] | (in[x * 2 + 1] << 8), transparent);
+			}
 		}
-	}
-	else if (type == TIM_TYPE_PALETTED_8_BPP) {
-		for (int i = 0; i < entries; i++) {
-			int32_t palette_pos = get_i16_le(bytes, &p);
-			image->pixels[pixel_pos++] = palette[(palette_pos >> 0) & 0xff];
-			image->pixels[pixel_pos++] = palette[(palette_pos >> 8) & 0xff];
+		else if (type == TIM_TYPE_PALETTED_8_BPP) {
+			for (uint32_t x = 0; x < width; x++) {
+				out[x] = palette[in[x]];
+			}
 		}
-	}
-	else if (type == TIM_TYPE_PALETTED_4_BPP) {
-		for (int i = 0; i < entries; i++) {
-			int32_t palette_pos = get_i16_le(bytes, &p);
-			image->pixels[pixel_pos++] = palette[(palette_pos >>  0) & 0xf];
-			image->pixels[pixel_pos++] = palette[(palette_pos >>  4) & 0xf];
-			image->pixels[pixel_pos++] = palette[(palette_pos >>  8) & 0xf];
-			image->pixels[pixel_pos++] = palette[(palette_pos >> 12) & 0xf];
+		else if (type == TIM_TYPE_PALETTED_4_BPP) {
+			for (uint32_t x = 0; x < width; x++) {
+				out[x] = palette[(in[x >> 1] >> ((x & 1) * 4)) & 0xf];
+			}
 		}
 	}
+}
 
+image_t *image_load_from_bytes(uint8_t *bytes, bool transparent) {
+	uint32_t width, height;
+	image_tim_size(bytes, &width, &height);
+	image_t *image = image_alloc(width, height);
+	image_decode_tim(bytes, transparent, image, 0, 0, width, height);
 	return image;
 }
 
@@ -121,117 +157,137 @@ image_t *image_load_from_bytes(uint8_t *bytes, bool transparent) {
 #define LZSS_BREAK_EVEN       ((1 + LZSS_INDEX_BIT_COUNT + LZSS_LENGTH_BIT_COUNT) / 9)
 #define LZSS_END_OF_STREAM    0
 #define LZSS_MOD_WINDOW(a)    ((a) & (LZSS_WINDOW_SIZE - 1))
+#define LZSS_MATCH_BIT_COUNT  (LZSS_INDEX_BIT_COUNT + LZSS_LENGTH_BIT_COUNT)
 
-void lzss_decompress(uint8_t *in_data, uint8_t *out_data) {
-	int16_t i;
-	int16_t current_position;
-	uint8_t cc;
-	int16_t match_length;
-	int16_t match_position;
-	uint32_t mask;
-	uint32_t return_value;
-	uint8_t in_bfile_mask;
-	int16_t in_bfile_rack;
-	int16_t value;
-	uint8_t window[LZSS_WINDOW_SIZE];
-
-	in_bfile_rack = 0;
-	in_bfile_mask = 0x80;
-
-	current_position = 1;
-	while (true) {
-		if (in_bfile_mask == 0x80) {
-			in_bfile_rack = (int16_t) * in_data++;
-		}
-
-		value = in_bfile_rack & in_bfile_mask;
-		in_bfile_mask >>= 1;
-		if (in_bfile_mask == 0) {
-			in_bfile_mask = 0x80;
-		}
-
-		if (value) {
-			mask = 1L << (8 - 1);
-			return_value = 0;
-			while (mask != 0) {
-				if (in_bfile_mask == 0x80) {
-					in_bfile_rack = (int16_t) * in_data++;
-				}
+// The stream is MSB first: a 1 bit followed by an 8 bit literal, or a 0 bit
+// followed by a 13 bit window position and 4 bit length. The encoder's
+// window starts at position 1 and mirrors the output, so matches are copied
+// from the output we already wrote. Bits are kept left aligned in a 64 bit
+// buffer that is refilled once per token; one token needs at most 18 bits.
 
-				if (in_bfile_rack & in_bfile_mask) {
-					return_value |= mask;
-				}
-				mask >>= 1;
-				in_bfile_mask >>= 1;
+void lzss_decompress(uint8_t *in_data, uint32_t in_len, uint8_t *out_data) {
+	uint8_t *in_end = in_data + in_len;
+	uint8_t *out_start = out_data;
+	uint64_t bits = 0;
+	int32_t bits_len = 0;
 
-				if (in_bfile_mask == 0) {
-					in_bfile_mask = 0x80;
+	while (true) {
+		if (bits_len < 1 + LZSS_MATCH_BIT_COUNT) {
+			if (in_end - in_data >= 8) {
+				uint64_t next =
+					((uint64_t)in_data[0] << 56) | ((uint64_t)in_data[1] << 48) |
+					((uint64_t)in_data[2] << 40) | ((uint64_t)in_data[3] << 32) |
+					((uint64_t)in_data[4] << 24) | ((uint64_t)in_data[5] << 16) |
+					((uint64_t)in_data[6] <<  8) | ((uint64_t)in_data[7] <<  0);
+				bits |= next >> bits_len;
+				in_data += (63 - bits_len) >> 3;
+				bits_len |= 56;
+			}
+			else {
+				// Near the end of the input; past it we read zeros, which
+				// decode as the end of stream marker
+				while (bits_len <= 56 && in_data < in_end) {
+					bits |= (uint64_t)*in_data++ << (56 - bits_len);
+					bits_len += 8;
 				}
 			}
-			cc = (uint8_t) return_value;
-			*out_data++ = cc;
-			window[ current_position ] = cc;
-			current_position = LZSS_MOD_WINDOW(current_position + 1);
 		}
-		else {
-			mask = 1L << (LZSS_INDEX_BIT_COUNT - 1);
-			return_value = 0;
-			while (mask != 0) {
-				if (in_bfile_mask == 0x80) {
-					in_bfile_rack = (int16_t) * in_data++;
-				}
-
-				if (in_bfile_rack & in_bfile_mask) {
-					return_value |= mask;
-				}
-				mask >>= 1;
-				in_bfile_mask >>= 1;
 
-				if (in_bfile_mask == 0) {
-					in_bfile_mask = 0x80;
-				}
-			}
-			match_position = (int16_t) return_value;
+		if (bits >> 63) {
+			*out_data++ = (uint8_t)(bits >> 55);
+			bits <<= 9;
+			bits_len -= 9;
+		}
+		else {
+			uint32_t match = (bits << 1) >> (64 - LZSS_MATCH_BIT_COUNT);
+			bits <<= 1 + LZSS_MATCH_BIT_COUNT;
+			bits_len -= 1 + LZSS_MATCH_BIT_COUNT;
 
+			uint32_t match_position = match >> LZSS_LENGTH_BIT_COUNT;
 			if (match_position == LZSS_END_OF_STREAM) {
 				break;
 			}
+			uint32_t match_length = (match & ((1 << LZSS_LENGTH_BIT_COUNT) - 1)) + LZSS_BREAK_EVEN + 1;
+
+			// Distance from the current window position (1 + bytes written) to
+			// the match; 0 means the oldest byte, a full window back
+			uint32_t written = out_data - out_start;
+			uint32_t distance = LZSS_MOD_WINDOW(written + 1 - match_position);
+			if (distance == 0) {
+				distance = LZSS_WINDOW_SIZE;
+			}
 
-			mask = 1L << (LZSS_LENGTH_BIT_COUNT - 1);
-			return_value = 0;
-			while (mask != 0) {
-				if (in_bfile_mask == 0x80) {
-					in_bfile_rack = (int16_t) * in_data++;
-				}
-
-				if (in_bfile_rack & in_bfile_mask) {
-					return_value |= mask;
+			// Matches may overlap the bytes they produce, so copy forward one
+			// at a time. Positions before the start of the output were never
+			// written by the encoder; treat them as zero.
+			if (distance <= written) {
+				uint8_t *src = out_data - distance;
+				for (uint32_t i = 0; i < match_length; i++) {
+					out_data[i] = src[i];
 				}
-				mask >>= 1;
-				in_bfile_mask >>= 1;
-
-				if (in_bfile_mask == 0) {
-					in_bfile_mask = 0x80;
+			}
+			else {
+				for (uint32_t i = 0; i < match_length; i++) {
+					int32_t src = written + i - distance;
+					out_data[i] = src >= 0 ? out_start[src] : 0;
 				}
 			}
-			match_length = (int16_t) return_value;
+			out_data += match_length;
+		}
+	}
+}
+// The original bit by bit decoder with its own window. Only used to verify
+// lzss_decompress() against the whole .cmp corpus, see image_check_compressed()
+
+static void lzss_decompress_reference(uint8_t *in_data, uint8_t *out_data) {
+	uint8_t window[LZSS_WINDOW_SIZE] = {0};
+	uint32_t current_position = 1;
+	uint8_t rack = 0;
+	uint8_t mask = 0x80;
+
+	#define LZSS_REFERENCE_READ_BITS(COUNT, RESULT) \
+		RESULT = 0; \
+		for (int bit = (COUNT) - 1; bit >= 0; bit--) { \
+			if (mask == 0x80) { \
+				rack = *in_data++; \
+			} \
+			if (rack & mask) { \
+				RESULT |= 1 << bit; \
+			} \
+			mask = mask == 1 ? 0x80 : mask >> 1; \
+		}
 
+	while (true) {
+		uint32_t is_literal, value;
+		LZSS_REFERENCE_READ_BITS(1, is_literal);
+		if (is_literal) {
+			LZSS_REFERENCE_READ_BITS(8, value);
+			*out_data++ = value;
+			window[current_position] = value;
+			current_position = LZSS_MOD_WINDOW(current_position + 1);
+		}
+		else {
+			uint32_t match_position, match_length;
+			LZSS_REFERENCE_READ_BITS(LZSS_INDEX_BIT_COUNT, match_position);
+			if (match_position == LZSS_END_OF_STREAM) {
+				break;
+			}
+			LZSS_REFERENCE_READ_BITS(LZSS_LENGTH_BIT_COUNT, match_length);
 			match_length += LZSS_BREAK_EVEN;
-
-			for (i = 0 ; i <= match_length ; i++) {
-				cc = window[LZSS_MOD_WINDOW(match_position + i)];
-				*out_data++ = cc;
-				window[current_position] = cc;
+			for (uint32_t i = 0; i <= match_length; i++) {
+				uint8_t c = window[LZSS_MOD_WINDOW(match_position + i)];
+				*out_data++ = c;
+				window[current_position] = c;
 				current_position = LZSS_MOD_WINDOW(current_position + 1);
 			}
 		}
 	}
+	#undef LZSS_REFERENCE_READ_BITS
 }
 
 cmp_t *image_load_compressed(char *name) {
-	printf("load cmp %s\n", name);
 	uint32_t compressed_size;
-	uint8_t *compressed_bytes = platform_load_asset(name, &compressed_size);
+	uint8_t *compressed_bytes = platform_map_asset(name, &compressed_size);
 
 	uint32_t p = 0;
 	int32_t decompressed_size = 0;
@@ -256,12 +312,106 @@ cmp_t *image_load_compressed(char *name) {
 		offset += get_i32_le(compressed_bytes, &p);
 	}
 
-	lzss_decompress(compressed_bytes + p, decompressed_bytes);
-	mem_temp_free(compressed_bytes);
+	lzss_decompress(compressed_bytes + p, compressed_size - p, decompressed_bytes);
+	platform_unmap_asset(compressed_bytes, compressed_size);
 
 	return cmp;
 }
 
+// Decodes every .cmp of the game with lzss_decompress() and the reference
+// decoder, compares the output and reports the throughput of both over the
+// whole corpus. Files that are not installed are skipped.
+
+#define IMAGE_CHECK_REPEAT 8
+
+static void image_check_compressed_file(const char *name, uint32_t *files, uint32_t *mismatches, double *bytes_total, double *time_fast, double *time_reference) {
+	FILE *f = platform_open_asset(name, "rb");
+	if (!f) {
+		return;
+	}
+	fclose(f);
+
+	uint32_t compressed_size;
+	uint8_t *compressed_bytes = platform_map_asset(name, &compressed_size);
+	uint32_t p = 0;
+	int32_t decompressed_size = 0;
+	int32_t image_count = get_i32_le(compressed_bytes, &p);
+	for (int i = 0; i < image_count; i++) {
+		decompressed_size += get_i32_le(compressed_bytes, &p);
+	}
+
+	// The reference decoder may write one match past the declared size
+	uint8_t *fast = mem_temp_alloc(decompressed_size + LZSS_WINDOW_SIZE);
+	uint8_t *reference = mem_temp_alloc(decompressed_size + LZSS_WINDOW_SIZE);
+
+	double start = platform_now();
+	for (int i = 0; i < IMAGE_CHECK_REPEAT; i++) {
+		lzss_decompress(compressed_bytes + p, compressed_size - p, fast);
+	}
+	*time_fast += platform_now() - start;
+
+	start = platform_now();
+	for (int i = 0; i < IMAGE_CHECK_REPEAT; i++) {
+		lzss_decompress_reference(compressed_bytes + p, reference);
+	}
+	*time_reference += platform_now() - start;
+
+	if (memcmp(fast, reference, decompressed_size) != 0) {
+		printf("cmp check %s: MISMATCH\n", name);
+		(*mismatches)++;
+	}
+	(*files)++;
+	*bytes_total += (double)decompressed_size * IMAGE_CHECK_REPEAT;
+
+	mem_temp_free(reference);
+	mem_temp_free(fast);
+	platform_unmap_asset(compressed_bytes, compressed_size);
+}
+
+void image_check_compressed(void) {
+	static const char *common[] = {
+		"wipeout/common/rescu.cmp", "wipeout/common/wicons.cmp", "wipeout/common/leeg.cmp",
+		"wipeout/common/pilot.cmp", "wipeout/common/alopt.cmp", "wipeout/common/pad1.cmp",
+		"wipeout/common/msdos.cmp", "wipeout/common/effects.cmp", "wipeout/common/allsh.cmp",
+		"wipeout/common/alcol.cmp", "wipeout/common/mine.cmp", "wipeout/textures/track.cmp",
+		"wipeout/textures/drfonts.cmp",
+	};
+	static const char *circut_files[] = {
+		"library.cmp", "scene.cmp", "sky.cmp", "sceneCom.cmp", "sceneSin.cmp", "sceneMul.cmp",
+	};
+
+	uint32_t files = 0, mismatches = 0;
+	double bytes_total = 0, time_fast = 0, time_reference = 0;
+
+	for (uint32_t i = 0; i < len(common); i++) {
+		image_check_compressed_file(common[i], &files, &mismatches, &bytes_total, &time_fast, &time_reference);
+	}
+	for (uint32_t i = 0; i < len(def.pilots); i++) {
+		image_check_compressed_file(def.pilots[i].portrait, &files, &mismatches, &bytes_total, &time_fast, &time_reference);
+	}
+	for (uint32_t i = 0; i < len(def.circuts); i++) {
+		for (uint32_t j = 0; j < len(def.circuts[i].settings); j++) {
+			// Both classes may share a path
+			const char *path = def.circuts[i].settings[j].path;
+			if (j > 0 && strcmp(path, def.circuts[i].settings[j - 1].path) == 0) {
+				continue;
+			}
+			for (uint32_t k = 0; k < len(circut_files); k++) {
+				image_check_compressed_file(get_path(path, circut_files[k]), &files, &mismatches, &bytes_total, &time_fast, &time_reference);
+			}
+		}
+	}
+
+	double mb = bytes_total / (1024 * 1024);
+	printf(
+		"cmp check: %u files, %u mismatches, %.2f MB decoded %d times; "
+		"lzss_decompress %.1f MB/s, reference %.1f MB/s\n",
+		files, mismatches, mb / IMAGE_CHECK_REPEAT, IMAGE_CHECK_REPEAT,
+		time_fast > 0 ? mb / time_fast : 0.0,
+		time_reference > 0 ? mb / time_reference : 0.0
+	);
+}
+
 uint16_t image_get_texture(char *name) {
 	printf("load: %s\n", name);
 	uint32_t size;
@@ -286,26 +436,123 @@ uint16_t image_get_texture_semi_trans(char *name) {
 	return texture_index;
 }
 
-texture_list_t image_get_compressed_textures(char *name) {
+typedef struct {
+	uint8_t **entries;
+	image_t *images;
+} image_decode_batch_t;
+
+static void image_decode_job(void *data, uint32_t index) {
+	image_decode_batch_t *batch = data;
+	image_t *image = &batch->images[index];
+	image_decode_tim(batch->entries[index], false, image, 0, 0, image->width, image->height);
+}
+
+// Decodes entries[i] into the preallocated images[i] on all threads
+
+void image_decode_parallel(uint8_t **entries, image_t *images, uint32_t len) {
+	image_decode_batch_t batch = {.entries = entries, .images = images};
+	jobs_parallel_for(image_decode_job, &batch, len);
+}
+
+// Decodes all images of the .cmp and writes them to a fresh bake. Textures
+// are only created when create_textures is set; the background loader just
+// fills the bake cache.
+
+static texture_list_t image_decode_compressed_textures(char *name, uint32_t source_hash, bool create_textures) {
 	cmp_t *cmp = image_load_compressed(name);
-	texture_list_t list = {.start = render_textures_len(), .len = cmp->len};
+	texture_list_t list = {.start = create_textures ? render_textures_len() : 0, .len = cmp->len};
+
+	FILE *bake_file = bake_create(name, BAKE_TYPE_TEXTURES, source_hash);
+	bake_write(bake_file, &cmp->len, sizeof(cmp->len));
+
+	// Decode batches of images on all threads, then create the textures for
+	// the whole batch in order
+	image_t *images = mem_temp_alloc(sizeof(image_t) * cmp->len);
+	for (uint32_t start = 0, end = 0; start < cmp->len; start = end) {
+		uint32_t batch_bytes = 0;
+		while (end < cmp->len) {
+			image_tim_size(cmp->entries[end], &images[end].width, &images[end].height);
+			uint32_t bytes = images[end].width * images[end].height * sizeof(rgba_t);
+			if (end > start && batch_bytes + bytes > IMAGE_DECODE_BATCH_BYTES) {
+				break;
+			}
+			batch_bytes += bytes;
+			end++;
+		}
 
-	for (int i = 0; i < cmp->len; i++) {
-		int32_t width, height;
-		image_t *image = image_load_from_bytes(cmp->entries[i], false);
+		rgba_t *pixels = mem_temp_alloc(batch_bytes);
+		for (uint32_t i = start, offset = 0; i < end; i++) {
+			images[i].pixels = pixels + offset;
+			offset += images[i].width * images[i].height;
+		}
+
+		image_decode_parallel(cmp->entries + start, images + start, end - start);
 
-		// char png_name[1024] = {0};
-		// sprintf(png_name, "%s.%d.png", name, i);
-		// stbi_write_png(png_name, image->width, image->height, 4, image->pixels, 0);
+		for (uint32_t i = start; i < end; i++) {
+			// char png_name[1024] = {0};
+			// sprintf(png_name, "%s.%d.png", name, i);
+			// stbi_write_png(png_name, images[i].width, images[i].height, 4, images[i].pixels, 0);
 
-		render_texture_create(image->width, image->height, image->pixels);
-		mem_temp_free(image);
+			if (create_textures) {
+				render_texture_create(images[i].width, images[i].height, images[i].pixels);
+			}
+			image_bake(bake_file, &images[i]);
+		}
+		mem_temp_free(pixels);
 	}
 
+	bake_finish(bake_file, name, BAKE_TYPE_TEXTURES, source_hash);
+	mem_temp_free(images);
 	mem_temp_free(cmp);
 	return list;
 }
 
+texture_list_t image_get_compressed_textures(char *name) {
+	uint32_t source_hash = bake_hash_asset(BAKE_HASH_INIT, name);
+	bake_t bake;
+	if (bake_open(&bake, name, BAKE_TYPE_TEXTURES, source_hash)) {
+		texture_list_t list = image_get_baked_textures(&bake);
+		bake_close(&bake);
+		return list;
+	}
+	return image_decode_compressed_textures(name, source_hash, true);
+}
+
+// Makes sure the bake for this .cmp is in the bake cache; safe to call from
+// the background thread.
+
+void image_prefetch_compressed_textures(char *name) {
+	uint32_t source_hash = bake_hash_asset(BAKE_HASH_INIT, name);
+	bake_t bake;
+	if (bake_open(&bake, name, BAKE_TYPE_TEXTURES, source_hash)) {
+		bake_close(&bake);
+		return;
+	}
+	image_decode_compressed_textures(name, source_hash, false);
+}
+
+// Baked textures are stored as the number of images, followed by the width,
+// height and rgba pixels of each image. The pixels are handed to the renderer
+// directly from the mapped file.
+
+texture_list_t image_get_baked_textures(bake_t *bake) {
+	uint32_t len = *(uint32_t *)bake_read(bake, sizeof(uint32_t));
+	texture_list_t list = {.start = render_textures_len(), .len = len};
+
+	for (uint32_t i = 0; i < len; i++) {
+		uint32_t *size = bake_read(bake, sizeof(uint32_t) * 2);
+		rgba_t *pixels = bake_read(bake, size[0] * size[1] * sizeof(rgba_t));
+		render_texture_create(size[0], size[1], pixels);
+	}
+	return list;
+}
+
+void image_bake(FILE *bake_file, image_t *image) {
+	uint32_t size[2] = {image->width, image->height};
+	bake_write(bake_file, size, sizeof(size));
+	bake_write(bake_file, image->pixels, image->width * image->height * sizeof(rgba_t));
+}
+
 uint16_t texture_from_list(texture_list_t tl, uint16_t index) {
 	error_if(index >= tl.len, "Texture %d not in list of len %d", index, tl.len);
 	return tl.start + index;
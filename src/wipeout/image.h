@@ -2,6 +2,11 @@
 #define INIT_H
 
 #include "../types.h"
+#include "bake.h"
+
+// Upper bound for the pixels decoded in parallel before they are handed to
+// the renderer
+#define IMAGE_DECODE_BATCH_BYTES (2 * 1024 * 1024)
 
 typedef struct {
 	uint16_t start;
@@ -23,12 +28,21 @@ typedef struct {
 
 image_t *image_alloc(uint32_t width, uint32_t height);
 void image_copy(image_t *src, image_t *dst, uint32_t sx, uint32_t sy, uint32_t sw, uint32_t sh, uint32_t dx, uint32_t dy);
+void image_tim_size(uint8_t *bytes, uint32_t *width, uint32_t *height);
+void image_decode_tim(uint8_t *bytes, bool transparent, image_t *dst, uint32_t dx, uint32_t dy, uint32_t w, uint32_t h);
 image_t *image_load_from_bytes(uint8_t *bytes, bool transparent);
+void image_decode_parallel(uint8_t **entries, image_t *images, uint32_t len);
 cmp_t *image_load_compressed(char *name);
 
+// Dev check: compare the lzss decoder with the reference over all .cmp files
+void image_check_compressed(void);
+
 uint16_t image_get_texture(char *name);
 uint16_t image_get_texture_semi_trans(char *name);
 texture_list_t image_get_compressed_textures(char *name);
+void image_prefetch_compressed_textures(char *name);
+texture_list_t image_get_baked_textures(bake_t *bake);
+void image_bake(FILE *bake_file, image_t *image);
 uint16_t texture_from_list(texture_list_t tl, uint16_t index);
 
 #endif
\ No newline at end of file
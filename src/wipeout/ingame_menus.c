@@ -73,7 +73,7 @@ static void button_music_track(menu_t *menu, int data) {
 }
 
 static void button_music_random(menu_t *menu, int data) {
-	sfx_music_play(rand_int(0, len(def.music)));
+	sfx_music_play(rand_int(&g.rand_fx, 0, len(def.music)));
 	sfx_music_mode(SFX_MUSIC_RANDOM);
 }
 
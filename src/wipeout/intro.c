@@ -57,14 +57,14 @@ void intro_init(void) {
 
 	int w = plm_get_width(plm);
 	int h = plm_get_height(plm);
-	frame_buffer = mem_bump(w * h * sizeof(rgba_t));
+	frame_buffer = mem_bump_uninit(w * h * sizeof(rgba_t));
 	for (int i = 0; i < w * h; i++) {
 		frame_buffer[i] = rgba(0, 0, 0, 255);
 	}
 	texture = render_texture_create(w, h, frame_buffer);
 
 	sfx_set_external_mix_cb(audio_mix);
-	audio_buffer = mem_bump(INTRO_AUDIO_BUFFER_LEN * sizeof(float) * 2);
+	audio_buffer = mem_bump_uninit(INTRO_AUDIO_BUFFER_LEN * sizeof(float) * 2);
 	audio_buffer_read_pos = 0;
 	audio_buffer_write_pos = 0;
 }
@@ -9,6 +9,7 @@
 #include "game.h"
 #include "image.h"
 #include "ui.h"
+#include "race.h"
 
 static void page_main_init(menu_t *menu);
 static void page_options_init(menu_t *menu);
@@ -612,7 +613,21 @@ static void button_circut_select(menu_t *menu, int data) {
 	game_set_scene(GAME_SCENE_RACE);
 }
 
-static void page_circut_additional_draw(menu_t *menu, int data) {}
+static void page_circut_prefetch(int circut) {
+	race_prefetch(circut);
+
+	// Progress bar below the circut image while the prefetch is running
+	float progress = race_prefetch_progress();
+	if (progress >= 0) {
+		vec2i_t size = vec2i(128 * progress, 2);
+		vec2i_t pos = ui_scaled_pos(UI_POS_MIDDLE | UI_POS_CENTER, vec2i(-64, 15));
+		render_push_2d(pos, ui_scaled(size), UI_COLOR_ACCENT, RENDER_NO_TEXTURE);
+	}
+}
+
+static void page_circut_additional_draw(menu_t *menu, int data) {
+	page_circut_prefetch(data);
+}
 
 static void page_circut_additional_init(menu_t *menu) {
 	menu_page_t *page = menu_push(menu, "ADDITIONAL CIRCUTS", page_circut_additional_draw);
@@ -640,6 +655,7 @@ static void page_circut_draw(menu_t *menu, int data) {
 	vec2i_t scaled_size = ui_scaled(size);
 	vec2i_t scaled_pos = ui_scaled_pos(UI_POS_MIDDLE | UI_POS_CENTER, vec2i(pos.x - size.x/2, pos.y - size.y/2));
 	render_push_2d(scaled_pos, scaled_size, rgba(128, 128, 128, 255), texture_from_list(track_images, data));
+	page_circut_prefetch(data);
 }
 
 static void page_circut_init(menu_t *menu) {
@@ -14,10 +14,26 @@
 #include "scene.h"
 #include "hud.h"
 #include "object.h"
+#include "bake.h"
+
+static Object *objects_load_baked(bake_t *bake, texture_list_t tl);
+static void objects_bake(char *name, uint32_t source_hash, Object *list, uint32_t len, texture_list_t tl);
 
 Object *objects_load(char *name, texture_list_t tl) {
+	// Texture indices are stored relative to the texture list, so a bake is
+	// valid for any list of the same length
+	uint32_t source_hash = bake_hash(BAKE_HASH_INIT, &tl.len, sizeof(tl.len));
+	source_hash = bake_hash(source_hash, &(uint32_t){sizeof(Object)}, sizeof(uint32_t));
+	source_hash = bake_hash_asset(source_hash, name);
+	bake_t bake;
+	if (bake_open(&bake, name, BAKE_TYPE_OBJECTS, source_hash)) {
+		Object *objectList = objects_load_baked(&bake, tl);
+		bake_close(&bake);
+		return objectList;
+	}
+
 	uint32_t length = 0;
-	uint8_t *bytes = platform_load_asset(name, &length);
+	uint8_t *bytes = platform_map_asset(name, &length);
 	if (!bytes) {
 		die("Failed to load file %s\n", name);
 	}
@@ -449,10 +465,96 @@ Object *objects_load(char *name, texture_list_t tl) {
 		} // each prim
 	} // each object
 
-	mem_temp_free(bytes);
+	platform_unmap_asset(bytes, length);
+	objects_bake(name, source_hash, objectList, (uint8_t *)mem_mark() - (uint8_t *)objectList, tl);
 	return objectList;
 }
 
+// Object lists are allocated in one contiguous block of the hunk. To bake and
+// restore them, all pointers in the block are rewritten from one base address
+// to another. Offsets relative to the start of the block are stored on disk.
+
+static void objects_relocate(uint8_t *data, uintptr_t from, uintptr_t to, int16_t texture_delta) {
+	#define relocate_ptr(P) (P) = (void *)((uintptr_t)(P) - from + to)
+
+	Object *object = (Object *)data;
+	while (object) {
+		Object *next = object->next ? (Object *)(data + ((uintptr_t)object->next - from)) : NULL;
+		Prm prm = {.ptr = data + ((uintptr_t)object->primitives - from)};
+
+		for (int i = 0; i < object->primitives_len; i++) {
+			switch (prm.primitive->type) {
+			case PRM_TYPE_F3: prm.f3 += 1; break;
+			case PRM_TYPE_F4: prm.f4 += 1; break;
+			case PRM_TYPE_FT3: prm.ft3->texture += texture_delta; prm.ft3 += 1; break;
+			case PRM_TYPE_FT4: prm.ft4->texture += texture_delta; prm.ft4 += 1; break;
+			case PRM_TYPE_G3: prm.g3 += 1; break;
+			case PRM_TYPE_G4: prm.g4 += 1; break;
+			case PRM_TYPE_GT3: prm.gt3->texture += texture_delta; prm.gt3 += 1; break;
+			case PRM_TYPE_GT4: prm.gt4->texture += texture_delta; prm.gt4 += 1; break;
+			case PRM_TYPE_LSF3: prm.lsf3 += 1; break;
+			case PRM_TYPE_LSF4: prm.lsf4 += 1; break;
+			case PRM_TYPE_LSFT3: prm.lsft3->texture += texture_delta; prm.lsft3 += 1; break;
+			case PRM_TYPE_LSFT4: prm.lsft4->texture += texture_delta; prm.lsft4 += 1; break;
+			case PRM_TYPE_LSG3: prm.lsg3 += 1; break;
+			case PRM_TYPE_LSG4: prm.lsg4 += 1; break;
+			case PRM_TYPE_LSGT3: prm.lsgt3->texture += texture_delta; prm.lsgt3 += 1; break;
+			case PRM_TYPE_LSGT4: prm.lsgt4->texture += texture_delta; prm.lsgt4 += 1; break;
+			case PRM_TYPE_TSPR:
+			case PRM_TYPE_BSPR: prm.spr->texture += texture_delta; prm.spr += 1; break;
+			case PRM_TYPE_SPLINE: prm.spline += 1; break;
+			case PRM_TYPE_POINT_LIGHT: prm.pointLight += 1; break;
+			case PRM_TYPE_SPOT_LIGHT: prm.spotLight += 1; break;
+			case PRM_TYPE_INFINITE_LIGHT: prm.infiniteLight += 1; break;
+			default: die("bad primitive type %x \n", prm.primitive->type);
+			}
+		}
+
+		relocate_ptr(object->vertices);
+		relocate_ptr(object->normals);
+		relocate_ptr(object->primitives);
+		if (object->next) {
+			relocate_ptr(object->next);
+		}
+		object = next;
+	}
+
+	#undef relocate_ptr
+}
+
+static void objects_bake(char *name, uint32_t source_hash, Object *list, uint32_t len, texture_list_t tl) {
+	if (len == 0) {
+		return;
+	}
+
+	FILE *bake_file = bake_create(name, BAKE_TYPE_OBJECTS, source_hash);
+	if (!bake_file) {
+		return;
+	}
+
+	// Rewrite the list in place to be relative to its start, store it and
+	// rewrite it back. We also keep the alignment of the start address, so
+	// that all objects end up with the same alignment when restored.
+	uint8_t *data = (uint8_t *)list;
+	uint32_t header[2] = {len, (uintptr_t)data & 7};
+	objects_relocate(data, (uintptr_t)data, 0, -tl.start);
+	bake_write(bake_file, header, sizeof(header));
+	bake_write(bake_file, data, len);
+	objects_relocate(data, 0, (uintptr_t)data, tl.start);
+	bake_finish(bake_file, name, BAKE_TYPE_OBJECTS, source_hash);
+}
+
+static Object *objects_load_baked(bake_t *bake, texture_list_t tl) {
+	uint32_t *header = bake_read(bake, sizeof(uint32_t) * 2);
+	uint32_t len = header[0];
+	uint32_t align = header[1];
+
+	uint8_t *data = (uint8_t *)mem_bump_uninit(len + align) + align;
+	memcpy(data, bake_read(bake, len), len);
+	objects_relocate(data, 0, (uintptr_t)data, tl.start);
+	return (Object *)data;
+}
+
 
 void object_draw(Object *object, mat4_t *mat) {
 	vec3_t *vertex = object->vertices;
@@ -2,9 +2,11 @@
 #include "../utils.h"
 #include "../system.h"
 #include "../render.h"
+#include "../profile.h"
 
 #include "particle.h"
 #include "image.h"
+#include "game.h"
 
 static particle_t *particles;
 static int particles_active = 0;
@@ -21,6 +23,7 @@ void particles_init(void) {
 }
 
 void particles_update(void) {
+	PROFILE_BEGIN("particles_update");
 	for (int i = 0; i < particles_active; i++) {
 		particle_t *p = &particles[i];
 
@@ -31,6 +34,7 @@ void particles_update(void) {
 			continue;
 		}
 	}
+	PROFILE_END("particles_update");
 }
 
 void particles_draw(void) {
@@ -53,6 +57,25 @@ void particles_draw(void) {
 	render_set_blend_mode(RENDER_BLEND_NORMAL);
 }
 
+uint32_t particles_snapshot_size_max(void) {
+	return sizeof(int32_t) + sizeof(particle_t) * PARTICLES_MAX;
+}
+
+uint32_t particles_snapshot_save(uint8_t *bytes) {
+	int32_t count = particles_active;
+	memcpy(bytes, &count, sizeof(count));
+	memcpy(bytes + sizeof(count), particles, sizeof(particle_t) * count);
+	return sizeof(count) + sizeof(particle_t) * count;
+}
+
+uint32_t particles_snapshot_restore(uint8_t *bytes) {
+	int32_t count;
+	memcpy(&count, bytes, sizeof(count));
+	memcpy(particles, bytes + sizeof(count), sizeof(particle_t) * count);
+	particles_active = count;
+	return sizeof(count) + sizeof(particle_t) * count;
+}
+
 void particles_spawn(vec3_t position, uint16_t type, vec3_t velocity, int size) {
 	if (particles_active == PARTICLES_MAX) {
 		return;
@@ -63,7 +86,7 @@ void particles_spawn(vec3_t position, uint16_t type, vec3_t velocity, int size)
 	p->texture = texture_from_list(particle_textures, type);
 	p->position = position;
 	p->velocity = velocity;
-	p->timer = rand_float(0.75, 1.0);
+	p->timer = rand_float(&g.rand_fx, 0.75, 1.0);
 	p->size.x = size;
 	p->size.y = size;
 }
@@ -29,4 +29,9 @@ void particles_spawn(vec3_t position, uint16_t type, vec3_t velocity, int size);
 void particles_draw(void);
 void particles_update(void);
 
+// Snapshot support, see snapshot.h; save and restore return the bytes used
+uint32_t particles_snapshot_size_max(void);
+uint32_t particles_snapshot_save(uint8_t *bytes);
+uint32_t particles_snapshot_restore(uint8_t *bytes);
+
 #endif
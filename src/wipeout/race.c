@@ -4,6 +4,7 @@
 #include "../system.h"
 #include "../utils.h"
 #include "../render.h"
+#include "../jobs.h"
 
 #include "object.h"
 #include "track.h"
@@ -21,6 +22,7 @@
 #include "menu.h"
 #include "ship_ai.h"
 #include "ingame_menus.h"
+#include "snapshot.h"
 
 #define ATTRACT_DURATION 60.0
 
@@ -30,24 +32,109 @@ static bool has_show_credits = false;
 static float attract_start_time;
 static menu_t *active_menu = NULL;
 
+// The simulation state right after race_start(); race_restart() rewinds to it
+static uint8_t *start_snapshot;
+static uint32_t start_snapshot_len;
+
+// The circut prefetch runs on the background thread. It decodes the track
+// and scene textures into the bake cache while the menu keeps rendering;
+// race_init() then only copies from the cache and uploads to the GPU on the
+// main thread.
+typedef struct {
+	int circut;
+	int race_class;
+	int steps_done;
+	int steps_total;
+} race_prefetch_t;
+
+static race_prefetch_t prefetch = {.circut = -1};
+
+static void race_prefetch_task(void *data) {
+	race_prefetch_t *pf = data;
+	const circut_settings_t *cs = &def.circuts[pf->circut].settings[pf->race_class];
+	bool wipeout64_mode = def.circuts[pf->circut].release == GAME_WIPEOUT_64;
+	double start_time = platform_now();
+
+	track_prefetch(cs->path, wipeout64_mode);
+	jobs_lock();
+	pf->steps_done++;
+	jobs_unlock();
+
+	scene_prefetch(cs->path, wipeout64_mode);
+	jobs_lock();
+	pf->steps_done++;
+	jobs_unlock();
+
+	printf("prefetch circut %s: %.1fms\n", def.circuts[pf->circut].name, (platform_now() - start_time) * 1000.0);
+}
+
+// Starts prefetching the circut in the background, unless it was already
+// prefetched or another prefetch is still busy. Cheap enough to call every
+// frame.
+void race_prefetch(int circut) {
+	if (
+		(prefetch.circut == circut && prefetch.race_class == g.race_class) ||
+		jobs_background_busy(JOBS_BACKGROUND_PREFETCH)
+	) {
+		return;
+	}
+
+	prefetch = (race_prefetch_t){
+		.circut = circut,
+		.race_class = g.race_class,
+		.steps_done = 0,
+		.steps_total = 2
+	};
+	if (!jobs_background_start(JOBS_BACKGROUND_PREFETCH, race_prefetch_task, &prefetch)) {
+		prefetch.circut = -1;
+	}
+}
+
+// Returns the progress of the running prefetch from 0..1, or -1 if none is
+// running
+float race_prefetch_progress(void) {
+	if (!jobs_background_busy(JOBS_BACKGROUND_PREFETCH)) {
+		return -1;
+	}
+	jobs_lock();
+	float progress = (float)prefetch.steps_done / prefetch.steps_total;
+	jobs_unlock();
+	return progress;
+}
+
 void race_init(void) {
+	// Finish a prefetch that may still be running; even if it was for another
+	// circut, it must not run concurrently with the load below
+	jobs_background_wait(JOBS_BACKGROUND_PREFETCH);
+	prefetch.circut = -1;
+
+	double load_start_time = platform_now();
+	mem_set_tag(MEM_TAG_UI);
 	ingame_menus_load();
 	menu_is_scroll_text = false;
 
 	const circut_settings_t *cs = &def.circuts[g.circut].settings[g.race_class];
+	mem_set_tag(MEM_TAG_TRACK);
 	track_load(cs->path);
+	mem_set_tag(MEM_TAG_SCENE);
 	scene_load(cs->path, cs->sky_y_offset);
+	mem_set_tag(MEM_TAG_NONE);
 	
 	if (g.circut == CIRCUT_SILVERSTREAM && g.race_class == RACE_CLASS_RAPIER) {
 		scene_init_aurora_borealis();	
 	} 
+	printf("load circut %s: %.1fms\n", def.circuts[g.circut].name, (platform_now() - load_start_time) * 1000.0);
 
 	if (g.is_attract_mode) {
-		g.pilot = rand_int(0, len(def.pilots));
+		g.pilot = rand_int(&g.rand_sim, 0, len(def.pilots));
 	}
 	race_start();
 	// render_textures_dump("texture_atlas.png");
 
+	start_snapshot_len = snapshot_size_max();
+	start_snapshot = mem_bump(start_snapshot_len);
+	start_snapshot_len = snapshot_save(start_snapshot, start_snapshot_len);
+
 	if (g.is_attract_mode) {
 		attract_start_time = system_time();
 
@@ -57,7 +144,7 @@ void race_init(void) {
 		}
 
 		g.camera.update_func = camera_update_attract_random;
-		if (!has_show_credits || rand_int(0, 10) == 0) {
+		if (!has_show_credits || rand_int(&g.rand_sim, 0, 10) == 0) {
 			active_menu = text_scroll_menu_init(def.credits, len(def.credits));
 			menu_is_scroll_text = true;
 			has_show_credits = true;
@@ -175,7 +262,28 @@ void race_restart(void) {
 		}
 	}
 
-	race_start();
+	// Rewind to the start of the race instead of initializing everything
+	// again. The rng streams keep running so the ai doesn't repeat the last
+	// attempt.
+	rand_t rand_sim = g.rand_sim;
+	rand_t rand_fx = g.rand_fx;
+	int lives = g.lives;
+	if (!snapshot_restore(start_snapshot, start_snapshot_len)) {
+		race_start();
+		return;
+	}
+	g.rand_sim = rand_sim;
+	g.rand_fx = rand_fx;
+	g.lives = lives;
+
+	// Shuffle the grid and reserve the sfx loops again, just like
+	// race_start() does
+	sfx_reset();
+	sfx_stop_oneshots();
+	ships_init(g.track.sections);
+	droid_init(&g.droid, &g.ships[g.pilot]);
+	scene_set_start_booms(0);
+	active_menu = NULL;
 }
 
 static bool sort_points_compare(pilot_points_t *pa, pilot_points_t *pb) {
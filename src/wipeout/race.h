@@ -11,4 +11,7 @@ void race_end(void);
 void race_next(void);
 void race_release_control(void);
 
+void race_prefetch(int circut);
+float race_prefetch_progress(void);
+
 #endif
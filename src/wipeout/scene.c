@@ -1,6 +1,7 @@
 #include "../mem.h"
 #include "../utils.h"
 #include "../system.h"
+#include "../profile.h"
 
 #include "object.h"
 #include "track.h"
@@ -49,6 +50,26 @@ void scene_pulsate_red_light(Object *obj);
 void scene_move_oil_pump(Object *obj);
 void scene_update_aurora_borealis(void);
 
+// Fills the bake cache with the sky and scene textures of a circut and hashes
+// the models; runs on the background thread, see track_prefetch().
+
+void scene_prefetch(const char *base_path, bool wipeout64_mode) {
+	if (wipeout64_mode) {
+		image_prefetch_compressed_textures(get_path("wipeout/track01/", "sky.cmp"));
+		bake_hash_asset(BAKE_HASH_INIT, get_path("wipeout/track01/", "sky.prm"));
+		image_prefetch_compressed_textures(get_path(base_path, "sceneCom.cmp"));
+		bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "sceneCom.prm"));
+		image_prefetch_compressed_textures(get_path(base_path, "sceneSin.cmp"));
+		bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "sceneSin.prm"));
+	}
+	else {
+		image_prefetch_compressed_textures(get_path(base_path, "sky.cmp"));
+		bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "sky.prm"));
+		image_prefetch_compressed_textures(get_path(base_path, "scene.cmp"));
+		bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "scene.prm"));
+	}
+}
+
 void scene_load(const char *base_path, float sky_y_offset) {
 	bool multiplayer = false;
 	if (def.circuts[g.circut].release == GAME_WIPEOUT_64) {
@@ -142,6 +163,7 @@ void scene_update(void) {
 }
 
 void scene_draw(camera_t *camera) {
+	PROFILE_BEGIN("scene_draw");
 	// Sky
 	render_set_depth_write(false);
 	mat4_set_translation(&sky_object->mat, vec3_add(camera->position, sky_offset));
@@ -168,6 +190,7 @@ void scene_draw(camera_t *camera) {
 		}
 		object = object->next;
 	}
+	PROFILE_END("scene_draw");
 }
 
 void scene_set_start_booms(int light_index) {
@@ -5,6 +5,7 @@
 #include "camera.h"
 
 void scene_load(const char *path, float sky_y_offset);
+void scene_prefetch(const char *path, bool wipeout64_mode);
 void scene_draw(camera_t *camera);
 void scene_init(void);
 void scene_set_start_booms(int num_lights);
@@ -57,11 +57,17 @@ typedef struct {
 
 #define SFX_MAX 64
 #define SFX_MAX_ACTIVE 16
+#define SFX_MIX_BLOCK_LEN 256
+#define SFX_COMMANDS_LEN 256 // must be a power of two
+#define SFX_MUSIC_RING_LEN (1 << 15) // frames; must be a power of two
 
 void sfx_load(void);
+void sfx_cleanup(void);
+void sfx_update(void);
 void sfx_stero_mix(float *buffer, uint32_t len);
 void sfx_set_external_mix_cb(void (*cb)(float *, uint32_t len));
 void sfx_reset(void);
+void sfx_stop_oneshots(void);
 void sfx_pause(void);
 void sfx_unpause(void);
 
@@ -1,6 +1,7 @@
 #include "../mem.h"
 #include "../utils.h"
 #include "../system.h"
+#include "../profile.h"
 
 #include "object.h"
 #include "scene.h"
@@ -64,7 +65,7 @@ void ships_init(section_t *section) {
 
 	// Randomize order for single race or new championship
 	if (g.race_type != RACE_TYPE_CHAMPIONSHIP || g.circut == CIRCUT_ALTIMA_VII) {
-		shuffle(ranks_to_pilots, len(ranks_to_pilots));
+		shuffle(&g.rand_sim, ranks_to_pilots, len(ranks_to_pilots));
 	}
 
 	// Randomize some tiers in an ongoing championship
@@ -73,8 +74,8 @@ void ships_init(section_t *section) {
 		for (int i = 0; i < len(g.ships); i++) {
 			ranks_to_pilots[i] = g.championship_ranks[i].pilot;
 		}		
-		shuffle(ranks_to_pilots, 2); // shuffle 0..1
-		shuffle(ranks_to_pilots + 4, len(ranks_to_pilots)-5); // shuffle 4..len-1
+		shuffle(&g.rand_sim, ranks_to_pilots, 2); // shuffle 0..1
+		shuffle(&g.rand_sim, ranks_to_pilots + 4, len(ranks_to_pilots)-5); // shuffle 4..len-1
 	}
 
 	// player is always last
@@ -121,6 +122,7 @@ static inline bool sort_rank_compare(pilot_points_t *pa, pilot_points_t *pb) {
 }
 
 void ships_update(void) {
+	PROFILE_BEGIN("ships_update");
 	if (g.race_type == RACE_TYPE_TIME_TRIAL) {
 		ship_update(&g.ships[g.pilot]);
 	}
@@ -141,6 +143,7 @@ void ships_update(void) {
 			}
 		}
 	}
+	PROFILE_END("ships_update");
 }
 
 void ships_reset_exhaust_plumes(void) {
@@ -518,9 +521,9 @@ void ship_update(ship_t *self) {
 
 	for (int i = 0; i < 3; i++) {
 		if (self->exhaust_plume[i].v != NULL) {
-			self->exhaust_plume[i].v->z = self->exhaust_plume[i].initial.z - exhaust_len + (rand_int(-16383, 16383) >> 9);
-			self->exhaust_plume[i].v->x = self->exhaust_plume[i].initial.x + (rand_int(-16383, 16383) >> 11);
-			self->exhaust_plume[i].v->y = self->exhaust_plume[i].initial.y + (rand_int(-16383, 16383) >> 11);
+			self->exhaust_plume[i].v->z = self->exhaust_plume[i].initial.z - exhaust_len + (rand_int(&g.rand_fx, -16383, 16383) >> 9);
+			self->exhaust_plume[i].v->x = self->exhaust_plume[i].initial.x + (rand_int(&g.rand_fx, -16383, 16383) >> 11);
+			self->exhaust_plume[i].v->y = self->exhaust_plume[i].initial.y + (rand_int(&g.rand_fx, -16383, 16383) >> 11);
 		}
 	}
 
@@ -844,10 +847,12 @@ void ship_collide_with_track(ship_t *self, track_face_t *face) {
 
 bool ship_intersects_ship(ship_t *self, ship_t *other) {
 	// Get 4 points of collision model in world space
-	vec3_t a = vec3_transform(other->collision_model->vertices[0], &other->mat);
-	vec3_t b = vec3_transform(other->collision_model->vertices[1], &other->mat);
-	vec3_t c = vec3_transform(other->collision_model->vertices[2], &other->mat);
-	vec3_t d = vec3_transform(other->collision_model->vertices[3], &other->mat);
+	vec3_t other_vertices[4];
+	vec3_transform_array(other->collision_model->vertices, other_vertices, 4, &other->mat);
+	vec3_t a = other_vertices[0];
+	vec3_t b = other_vertices[1];
+	vec3_t c = other_vertices[2];
+	vec3_t d = other_vertices[3];
 
 	vec3_t other_points[6] = {b, a, d, a, a, b};
 	vec3_t other_lines[6] = {
@@ -860,6 +865,10 @@ bool ship_intersects_ship(ship_t *self, ship_t *other) {
 	};
 
 
+	// Transform all of our collision model once instead of per primitive
+	vec3_t self_vertices[self->collision_model->vertices_len];
+	vec3_transform_array(self->collision_model->vertices, self_vertices, self->collision_model->vertices_len, &self->mat);
+
 	Prm poly = {.primitive = other->collision_model->primitives};
 	int primitives_len = other->collision_model->primitives_len;
 
@@ -879,9 +888,9 @@ bool ship_intersects_ship(ship_t *self, ship_t *other) {
 				indices = poly.gt3++->coords; break;
 			default: die("Can't happen?");
 		}
-		p1 =  vec3_transform(self->collision_model->vertices[indices[0]], &self->mat);
-		p2 =  vec3_transform(self->collision_model->vertices[indices[1]], &self->mat);
-		p3 =  vec3_transform(self->collision_model->vertices[indices[2]], &self->mat);
+		p1 = self_vertices[indices[0]];
+		p2 = self_vertices[indices[1]];
+		p3 = self_vertices[indices[2]];
 
 		// Find polyGon line vectors
 		vec3_t p1p2 = vec3_sub(p2, p1);
@@ -0,0 +1,179 @@
+#include <string.h>
+
+#include "../utils.h"
+
+#include "game.h"
+#include "track.h"
+#include "ship.h"
+#include "weapon.h"
+#include "particle.h"
+#include "snapshot.h"
+
+// Layout: header, one snapshot_pickup_t for every track pickup, then the
+// active weapons and particles as written by their modules.
+
+typedef struct {
+	uint32_t version;
+	uint32_t size;
+	int32_t circut;
+	int32_t race_class;
+	int32_t section_count;
+	int32_t pickups_len;
+
+	bool is_new_lap_record;
+	bool is_new_race_record;
+	float best_lap;
+	float race_time;
+	int lives;
+	int race_position;
+	float lap_times[NUM_PILOTS][NUM_LAPS];
+	pilot_points_t race_ranks[NUM_PILOTS];
+
+	camera_t camera;
+	droid_t droid;
+	ship_t ships[NUM_PILOTS];
+
+	rand_t rand_sim;
+	rand_t rand_fx;
+} snapshot_header_t;
+
+typedef struct {
+	float cooldown_timer;
+	rgba_t color;
+	uint8_t flags;
+} snapshot_pickup_t;
+
+uint32_t snapshot_size_max(void) {
+	return
+		sizeof(snapshot_header_t) +
+		sizeof(snapshot_pickup_t) * g.track.pickups_len +
+		weapons_snapshot_size_max() +
+		particles_snapshot_size_max();
+}
+
+uint32_t snapshot_save(void *buffer, uint32_t capacity) {
+	error_if(capacity < snapshot_size_max(), "Snapshot buffer too small (%u bytes)", capacity);
+
+	uint8_t *bytes = buffer;
+	snapshot_header_t *h = buffer;
+	h->version = SNAPSHOT_VERSION;
+	h->circut = g.circut;
+	h->race_class = g.race_class;
+	h->section_count = g.track.section_count;
+	h->pickups_len = g.track.pickups_len;
+
+	h->is_new_lap_record = g.is_new_lap_record;
+	h->is_new_race_record = g.is_new_race_record;
+	h->best_lap = g.best_lap;
+	h->race_time = g.race_time;
+	h->lives = g.lives;
+	h->race_position = g.race_position;
+	memcpy(h->lap_times, g.lap_times, sizeof(g.lap_times));
+	memcpy(h->race_ranks, g.race_ranks, sizeof(g.race_ranks));
+
+	h->camera = g.camera;
+	h->camera.section = SNAPSHOT_PTR_ENCODE(g.camera.section, g.track.sections);
+	h->droid = g.droid;
+	h->droid.section = SNAPSHOT_PTR_ENCODE(g.droid.section, g.track.sections);
+	for (uint32_t i = 0; i < len(g.ships); i++) {
+		ship_t *s = &h->ships[i];
+		*s = g.ships[i];
+		s->section = SNAPSHOT_PTR_ENCODE(s->section, g.track.sections);
+		s->prev_section = SNAPSHOT_PTR_ENCODE(s->prev_section, g.track.sections);
+		s->weapon_target = SNAPSHOT_PTR_ENCODE(s->weapon_target, g.ships);
+	}
+
+	h->rand_sim = g.rand_sim;
+	h->rand_fx = g.rand_fx;
+
+	uint32_t p = sizeof(snapshot_header_t);
+	for (int i = 0; i < g.track.pickups_len; i++) {
+		track_pickup_t *pickup = &g.track.pickups[i];
+		snapshot_pickup_t sp = {
+			.cooldown_timer = pickup->cooldown_timer,
+			.color = pickup->face->tris[0].vertices[0].color,
+			.flags = pickup->face->flags
+		};
+		memcpy(bytes + p, &sp, sizeof(sp));
+		p += sizeof(sp);
+	}
+
+	p += weapons_snapshot_save(bytes + p);
+	p += particles_snapshot_save(bytes + p);
+
+	h->size = p;
+	return p;
+}
+
+bool snapshot_restore(void *buffer, uint32_t len) {
+	uint8_t *bytes = buffer;
+	snapshot_header_t *h = buffer;
+	if (
+		len < sizeof(snapshot_header_t) || h->size != len ||
+		h->version != SNAPSHOT_VERSION ||
+		h->circut != g.circut ||
+		h->race_class != g.race_class ||
+		h->section_count != g.track.section_count ||
+		h->pickups_len != g.track.pickups_len
+	) {
+		return false;
+	}
+
+	g.is_new_lap_record = h->is_new_lap_record;
+	g.is_new_race_record = h->is_new_race_record;
+	g.best_lap = h->best_lap;
+	g.race_time = h->race_time;
+	g.lives = h->lives;
+	g.race_position = h->race_position;
+	memcpy(g.lap_times, h->lap_times, sizeof(g.lap_times));
+	memcpy(g.race_ranks, h->race_ranks, sizeof(g.race_ranks));
+
+	g.camera = h->camera;
+	g.camera.section = SNAPSHOT_PTR_DECODE(h->camera.section, g.track.sections);
+
+	sfx_t *sfx_tractor = g.droid.sfx_tractor;
+	g.droid = h->droid;
+	g.droid.section = SNAPSHOT_PTR_DECODE(h->droid.section, g.track.sections);
+	g.droid.sfx_tractor = sfx_tractor;
+	flags_rm(g.droid.sfx_tractor->flags, SFX_PLAY);
+
+	for (uint32_t i = 0; i < len(g.ships); i++) {
+		ship_t *s = &g.ships[i];
+		ship_t prev = *s;
+		*s = h->ships[i];
+		s->section = SNAPSHOT_PTR_DECODE(s->section, g.track.sections);
+		s->prev_section = SNAPSHOT_PTR_DECODE(s->prev_section, g.track.sections);
+		s->weapon_target = SNAPSHOT_PTR_DECODE(s->weapon_target, g.ships);
+		s->sfx_engine_thrust = prev.sfx_engine_thrust;
+		s->sfx_engine_intake = prev.sfx_engine_intake;
+		s->sfx_turbulence = prev.sfx_turbulence;
+		s->sfx_shield = prev.sfx_shield;
+
+		// Silence the kept loops until the next ship update sets them again
+		sfx_t *loops[] = {s->sfx_engine_thrust, s->sfx_engine_intake, s->sfx_turbulence, s->sfx_shield};
+		for (uint32_t j = 0; j < len(loops); j++) {
+			if (loops[j]) {
+				loops[j]->volume = 0;
+			}
+		}
+	}
+
+	g.rand_sim = h->rand_sim;
+	g.rand_fx = h->rand_fx;
+
+	uint32_t p = sizeof(snapshot_header_t);
+	for (int i = 0; i < g.track.pickups_len; i++) {
+		track_pickup_t *pickup = &g.track.pickups[i];
+		snapshot_pickup_t sp;
+		memcpy(&sp, bytes + p, sizeof(sp));
+		p += sizeof(sp);
+
+		pickup->cooldown_timer = sp.cooldown_timer;
+		pickup->face->flags = sp.flags;
+		track_face_set_color(pickup->face, sp.color);
+	}
+
+	p += weapons_snapshot_restore(bytes + p);
+	p += particles_snapshot_restore(bytes + p);
+	return true;
+}
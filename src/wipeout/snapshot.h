@@ -0,0 +1,28 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "../types.h"
+
+// A snapshot captures the complete race simulation state: ships, droid,
+// camera, weapons, particles, pickups, race timers and the rng streams.
+// Pointers into the track sections and to other ships are stored as indices,
+// so a snapshot stays valid when the same circut is loaded again. Models,
+// update functions and sfx are loaded once at startup and stored as they are;
+// the sfx nodes of the running race are kept on restore.
+
+#define SNAPSHOT_VERSION 1
+
+// Encode a pointer into an array as index + 1 (0 for NULL) and back
+#define SNAPSHOT_PTR_ENCODE(PTR, BASE) ((PTR) ? (void *)(uintptr_t)((PTR) - (BASE) + 1) : NULL)
+#define SNAPSHOT_PTR_DECODE(PTR, BASE) ((PTR) ? (BASE) + ((uintptr_t)(PTR) - 1) : NULL)
+
+// The buffer size needed to hold any snapshot of the current race
+uint32_t snapshot_size_max(void);
+
+// Returns the number of bytes written
+uint32_t snapshot_save(void *buffer, uint32_t capacity);
+
+// Returns false if the snapshot was taken on a different circut or version
+bool snapshot_restore(void *buffer, uint32_t len);
+
+#endif
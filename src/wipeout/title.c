@@ -36,12 +36,12 @@ void title_update(void) {
 		sfx_music_mode(SFX_MUSIC_RANDOM);
 		has_shown_attract = true;
 		g.is_attract_mode = true;
-		g.pilot = rand_int(0, len(def.pilots));
+		g.pilot = rand_int(&g.rand_sim, 0, len(def.pilots));
 		do {
-			g.circut = rand_int(0, NUM_CIRCUTS);
+			g.circut = rand_int(&g.rand_sim, 0, NUM_CIRCUTS);
 		} while (!g.installed_circuts[g.circut] || def.circuts[g.circut].is_bonus_circut);
 
-		g.race_class = rand_int(0, NUM_RACE_CLASSES);
+		g.race_class = rand_int(&g.rand_sim, 0, NUM_RACE_CLASSES);
 		g.race_type = RACE_TYPE_SINGLE;
 		game_set_scene(GAME_SCENE_RACE);
 	}
@@ -3,19 +3,58 @@
 #include "../render.h"
 #include "../system.h"
 #include "../platform.h"
+#include "../jobs.h"
+#include "../profile.h"
 
 #include "object.h"
 #include "track.h"
 #include "camera.h"
 #include "object.h"
 #include "game.h"
+#include "bake.h"
+
+typedef struct {
+	ttf_t *ttf;
+	cmp_t *cmp;
+	image_t *tiles;
+	image_t *sub_tiles;
+	uint16_t *sub_tile_slots;
+	uint32_t first;
+	int tiles_per_side;
+	int sub_tile_size;
+	bool wipeout64_mode;
+} track_tile_batch_t;
+
+static void track_load_tile_job(void *data, uint32_t index) {
+	track_tile_batch_t *batch = data;
+	uint32_t i = batch->first + index;
+	image_t *tile = &batch->tiles[index];
+	int sub_tile_size = batch->sub_tile_size;
+
+	// Wipeout 64 tiles are stored whole
+	if (batch->wipeout64_mode) {
+		image_decode_tim(batch->cmp->entries[i], false, tile, 0, 0, tile->width, tile->height);
+		return;
+	}
 
-void track_load(const char *base_path) {
-	// Load and assemble high res track tiles
+	for (int tx = 0; tx < batch->tiles_per_side; tx++) {
+		for (int ty = 0; ty < batch->tiles_per_side; ty++) {
+			uint16_t sub_tile_index = batch->ttf->tiles[i].near[ty * batch->tiles_per_side + tx];
+			image_t *sub_tile = &batch->sub_tiles[batch->sub_tile_slots[sub_tile_index]];
+			image_copy(sub_tile, tile, 0, 0, sub_tile_size, sub_tile_size, tx * sub_tile_size, ty * sub_tile_size);
+		}
+	}
+}
+
+// Load and assemble high res track tiles and write them to a fresh bake.
+// Textures are only created when create_textures is set; the background
+// loader just fills the bake cache.
 
-	bool wipeout64_mode = def.circuts[g.circut].release == GAME_WIPEOUT_64;
-	g.track.textures.start = render_textures_len();
-	g.track.textures.len = 0;
+static void track_load_tiles(const char *base_path, bool wipeout64_mode, uint32_t source_hash, bool create_textures) {
+	if (create_textures) {
+		g.track.textures.start = render_textures_len();
+		g.track.textures.len = 0;
+	}
 
 	ttf_t *ttf = track_load_tile_format(get_path(base_path, "library.ttf"));
 	cmp_t *cmp = image_load_compressed(get_path(base_path, "library.cmp"));
@@ -23,25 +62,98 @@ void track_load(const char *base_path) {
 	int sub_tile_size  = wipeout64_mode ? 64 : 32;
 	int tiles          = wipeout64_mode ? 1  : 4;
 	
-	image_t *temp_tile = image_alloc(temp_tile_size, temp_tile_size);
 	int len = wipeout64_mode ? cmp->len : ttf->len;
-	for (int i = 0; i < len; i++) {
-		for (int tx = 0; tx < tiles; tx++) {
-			for (int ty = 0; ty < tiles; ty++) {
-				uint32_t sub_tile_index = ttf->tiles[i].near[ty * tiles + tx];
-				image_t *sub_tile = image_load_from_bytes(cmp->entries[wipeout64_mode ? i : sub_tile_index], false);
-				image_copy(sub_tile, temp_tile, 0, 0, sub_tile_size, sub_tile_size, tx * sub_tile_size, ty * sub_tile_size);
-				mem_temp_free(sub_tile);
+
+	// Many tiles share the same near sub-tiles. Decode every distinct
+	// sub-tile once into a cache and compose the tiles from that.
+	uint32_t sub_tiles_len = 0;
+	uint32_t sub_tile_refs = 0;
+	void *cache = mem_temp_alloc((sizeof(image_t) + sizeof(uint8_t *) + sizeof(uint16_t)) * cmp->len);
+	image_t *sub_tiles = cache;
+	uint8_t **sub_tile_entries = (uint8_t **)(sub_tiles + cmp->len);
+	uint16_t *sub_tile_slots = (uint16_t *)(sub_tile_entries + cmp->len);
+	rgba_t *sub_tile_pixels = NULL;
+
+	if (!wipeout64_mode) {
+		memset(sub_tile_slots, 0xff, sizeof(uint16_t) * cmp->len);
+		for (int i = 0; i < len; i++) {
+			for (int s = 0; s < tiles * tiles; s++) {
+				uint16_t index = ttf->tiles[i].near[s];
+				error_if(index >= cmp->len, "Sub-tile %d not in library of len %d", index, cmp->len);
+				if (sub_tile_slots[index] == 0xffff) {
+					sub_tile_slots[index] = sub_tiles_len;
+					sub_tile_entries[sub_tiles_len++] = cmp->entries[index];
+				}
+				sub_tile_refs++;
 			}
 		}
-		render_texture_create(temp_tile->width, temp_tile->height, temp_tile->pixels);
-		g.track.textures.len++;
+
+		uint32_t sub_tile_pixels_len = sub_tile_size * sub_tile_size;
+		sub_tile_pixels = mem_temp_alloc(sub_tiles_len * sub_tile_pixels_len * sizeof(rgba_t));
+		for (uint32_t s = 0; s < sub_tiles_len; s++) {
+			sub_tiles[s] = (image_t){
+				.width = sub_tile_size,
+				.height = sub_tile_size,
+				.pixels = sub_tile_pixels + s * sub_tile_pixels_len
+			};
+		}
+		image_decode_parallel(sub_tile_entries, sub_tiles, sub_tiles_len);
+		printf("load tiles %s: %d sub-tiles decoded, %d decodes avoided\n", base_path, sub_tiles_len, sub_tile_refs - sub_tiles_len);
+	}
+
+	FILE *bake_file = bake_create(get_path(base_path, "library.ttf"), BAKE_TYPE_TEXTURES, source_hash);
+	bake_write(bake_file, &len, sizeof(len));
+
+	// Assemble batches of tiles on all threads, then create their textures
+	// in order
+	uint32_t tile_pixels = temp_tile_size * temp_tile_size;
+	uint32_t batch_len = max((uint32_t)(IMAGE_DECODE_BATCH_BYTES / (tile_pixels * sizeof(rgba_t))), 1u);
+	image_t *batch_tiles = mem_temp_alloc(sizeof(image_t) * batch_len);
+	rgba_t *pixels = mem_temp_alloc(tile_pixels * batch_len * sizeof(rgba_t));
+	for (uint32_t t = 0; t < batch_len; t++) {
+		batch_tiles[t] = (image_t){
+			.width = temp_tile_size,
+			.height = temp_tile_size,
+			.pixels = pixels + t * tile_pixels
+		};
 	}
 
-	mem_temp_free(temp_tile);
+	track_tile_batch_t batch = {
+		.ttf = ttf,
+		.cmp = cmp,
+		.tiles = batch_tiles,
+		.sub_tiles = sub_tiles,
+		.sub_tile_slots = sub_tile_slots,
+		.tiles_per_side = tiles,
+		.sub_tile_size = sub_tile_size,
+		.wipeout64_mode = wipeout64_mode
+	};
+	for (int i = 0; i < len; i += batch_len) {
+		uint32_t count = min((uint32_t)(len - i), batch_len);
+		batch.first = i;
+		jobs_parallel_for(track_load_tile_job, &batch, count);
+
+		for (uint32_t t = 0; t < count; t++) {
+			if (create_textures) {
+				render_texture_create(batch_tiles[t].width, batch_tiles[t].height, batch_tiles[t].pixels);
+				g.track.textures.len++;
+			}
+			image_bake(bake_file, &batch_tiles[t]);
+		}
+	}
+
+	bake_finish(bake_file, get_path(base_path, "library.ttf"), BAKE_TYPE_TEXTURES, source_hash);
+	mem_temp_free(pixels);
+	mem_temp_free(batch_tiles);
+	if (sub_tile_pixels) {
+		mem_temp_free(sub_tile_pixels);
+	}
+	mem_temp_free(cache);
 	mem_temp_free(cmp);
 	mem_temp_free(ttf);
+}
 
+static void track_load_geometry(const char *base_path, uint32_t source_hash) {
 	vec3_t *vertices = track_load_vertices(get_path(base_path, "track.trv"));
 	track_load_faces(get_path(base_path, "track.trf"), vertices);
 	mem_temp_free(vertices);
@@ -50,6 +162,75 @@ void track_load(const char *base_path) {
 	char *tex_path = get_path(base_path, "track.tex");
 	if (file_exists(tex_path)) track_load_texture_file(tex_path);
 
+	// Baked faces are stored in native layout, after the vertex and face count
+	FILE *bake_file = bake_create(get_path(base_path, "track.trf"), BAKE_TYPE_TRACK_FACES, source_hash);
+	bake_write(bake_file, &g.track.vertex_count, sizeof(g.track.vertex_count));
+	bake_write(bake_file, &g.track.face_count, sizeof(g.track.face_count));
+	bake_write(bake_file, g.track.faces, sizeof(track_face_t) * g.track.face_count);
+	bake_finish(bake_file, get_path(base_path, "track.trf"), BAKE_TYPE_TRACK_FACES, source_hash);
+}
+
+static void track_load_baked_geometry(bake_t *bake) {
+	g.track.vertex_count = *(int32_t *)bake_read(bake, sizeof(int32_t));
+	g.track.face_count = *(int32_t *)bake_read(bake, sizeof(int32_t));
+	g.track.faces = mem_bump(sizeof(track_face_t) * g.track.face_count);
+	memcpy(g.track.faces, bake_read(bake, sizeof(track_face_t) * g.track.face_count), sizeof(track_face_t) * g.track.face_count);
+}
+
+static uint32_t track_tiles_hash(const char *base_path) {
+	uint32_t hash = bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "library.ttf"));
+	return bake_hash_asset(hash, get_path(base_path, "library.cmp"));
+}
+
+// Fills the bake cache with the track tiles and hashes the geometry files, so
+// that a following track_load() only has to copy and upload. This runs on the
+// background thread and must not touch g or the renderer.
+
+void track_prefetch(const char *base_path, bool wipeout64_mode) {
+	bake_t bake;
+	uint32_t tiles_hash = track_tiles_hash(base_path);
+	if (bake_open(&bake, get_path(base_path, "library.ttf"), BAKE_TYPE_TEXTURES, tiles_hash)) {
+		bake_close(&bake);
+	}
+	else {
+		track_load_tiles(base_path, wipeout64_mode, tiles_hash, false);
+	}
+
+	bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "track.trv"));
+	bake_hash_asset(BAKE_HASH_INIT, get_path(base_path, "track.trf"));
+	char *tex_path = get_path(base_path, "track.tex");
+	if (file_exists(tex_path)) bake_hash_asset(BAKE_HASH_INIT, tex_path);
+}
+
+void track_load(const char *base_path) {
+	bake_t bake;
+	uint32_t tiles_hash = track_tiles_hash(base_path);
+	if (bake_open(&bake, get_path(base_path, "library.ttf"), BAKE_TYPE_TEXTURES, tiles_hash)) {
+		g.track.textures = image_get_baked_textures(&bake);
+		bake_close(&bake);
+	}
+	else {
+		track_load_tiles(base_path, def.circuts[g.circut].release == GAME_WIPEOUT_64, tiles_hash, true);
+	}
+
+	// The face uvs depend on the release and the layout on track_face_t, so 
+	// both go into the hash as well
+	game_release_t release = def.circuts[g.circut].release;
+	uint32_t geometry_hash = bake_hash(BAKE_HASH_INIT, &release, sizeof(release));
+	geometry_hash = bake_hash(geometry_hash, &(uint32_t){sizeof(track_face_t)}, sizeof(uint32_t));
+	geometry_hash = bake_hash_asset(geometry_hash, get_path(base_path, "track.trv"));
+	geometry_hash = bake_hash_asset(geometry_hash, get_path(base_path, "track.trf"));
+	char *tex_path = get_path(base_path, "track.tex");
+	if (file_exists(tex_path)) geometry_hash = bake_hash_asset(geometry_hash, tex_path);
+
+	if (bake_open(&bake, get_path(base_path, "track.trf"), BAKE_TYPE_TRACK_FACES, geometry_hash)) {
+		track_load_baked_geometry(&bake);
+		bake_close(&bake);
+	}
+	else {
+		track_load_geometry(base_path, geometry_hash);
+	}
+
 	track_load_sections(get_path(base_path, "track.trs"));
 
 	g.track.pickups_len = 0;
@@ -130,7 +311,7 @@ bool track_collect_pickups(track_face_t *face) {
 
 vec3_t *track_load_vertices(char *file_name) {
 	uint32_t size;
-	uint8_t *bytes = platform_load_asset(file_name, &size);
+	uint8_t *bytes = platform_map_asset(file_name, &size);
 
 	g.track.vertex_count = size / 16; // VECTOR_SIZE
 	vec3_t *vertices = mem_temp_alloc(sizeof(vec3_t) * g.track.vertex_count);
@@ -143,7 +324,7 @@ vec3_t *track_load_vertices(char *file_name) {
 		p += 4; // padding
 	}
 
-	mem_temp_free(bytes);
+	platform_unmap_asset(bytes, size);
 	return vertices;
 }
 
@@ -159,7 +340,7 @@ static const vec2_t wipeout64_track_uv[2][4] = {
 
 void track_load_faces(char *file_name, vec3_t *vertices) {
 	uint32_t size;
-	uint8_t *bytes = platform_load_asset(file_name, &size);
+	uint8_t *bytes = platform_map_asset(file_name, &size);
 
 	g.track.face_count = size / 20; // TRACK_FACE_DATA_SIZE
 	g.track.faces = mem_bump(sizeof(track_face_t) * g.track.face_count);
@@ -206,7 +387,7 @@ void track_load_faces(char *file_name, vec3_t *vertices) {
 		tf++;
 	}
 
-	mem_temp_free(bytes);
+	platform_unmap_asset(bytes, size);
 }
 
 void track_load_texture_file(char *tex_path) {
@@ -286,6 +467,7 @@ void track_draw_section(section_t *section) {
 }
 
 void track_draw(camera_t *camera) {	
+	PROFILE_BEGIN("track_draw");
 	render_set_model_mat(&mat4_identity());
 
 	// Calculate the camera forward vector, so we can cull everything that's
@@ -307,6 +489,7 @@ void track_draw(camera_t *camera) {
 			track_draw_section(s);
 		}
 	}
+	PROFILE_END("track_draw");
 }
 
 void track_cycle_pickups(void) {
@@ -55,6 +55,39 @@ char_set_t char_set[UI_SIZE_MAX] = {
 
 uint16_t icon_textures[UI_ICON_MAX];
 
+// Laid out text is cached as runs of tris relative to the text origin, keyed
+// by the string, size and ui scale. Labels are laid out once; numbers only
+// when their value changes. When the cache is full it is cleared as a whole.
+#define UI_TEXT_CACHE_LEN 512 // must be a power of two
+#define UI_TEXT_CACHE_TRIS 4096
+#define UI_TEXT_CACHE_CHARS 8192
+#define UI_TEXT_RUN_GLYPHS_MAX 256
+
+typedef struct {
+	uint32_t hash;
+	uint16_t text_start;
+	uint16_t tris_start;
+	uint16_t tris_len;
+	uint16_t width;
+	uint8_t size;
+	uint8_t scale;
+	bool used;
+} ui_text_run_t;
+
+static ui_text_run_t text_runs[UI_TEXT_CACHE_LEN];
+static uint32_t text_runs_len;
+static tris_t text_tris[UI_TEXT_CACHE_TRIS];
+static uint32_t text_tris_len;
+static char text_chars[UI_TEXT_CACHE_CHARS];
+static uint32_t text_chars_len;
+
+static void ui_text_cache_clear(void) {
+	clear(text_runs);
+	text_runs_len = 0;
+	text_tris_len = 0;
+	text_chars_len = 0;
+}
+
 void ui_load(void) {
 	texture_list_t tl = image_get_compressed_textures("wipeout/textures/drfonts.cmp");
 	char_set[UI_SIZE_16].texture   = texture_from_list(tl, 0);
@@ -66,6 +99,7 @@ void ui_load(void) {
 	icon_textures[UI_ICON_END]     = texture_from_list(tl, 7);
 	icon_textures[UI_ICON_DEL]     = texture_from_list(tl, 8);
 	icon_textures[UI_ICON_STAR]    = texture_from_list(tl, 9);
+	ui_text_cache_clear();
 }
 
 int ui_get_scale(void) {
@@ -182,9 +216,99 @@ void ui_draw_number(int num, vec2i_t pos, ui_text_size_t size, rgba_t color) {
 	ui_draw_text(text_buffer + i, pos, size, color);
 }
 
+static ui_text_run_t *ui_text_run(const char *text, ui_text_size_t size) {
+	uint32_t hash = 2166136261u;
+	uint32_t text_len = 0;
+	uint32_t glyphs_len = 0;
+	for (; text[text_len] != 0; text_len++) {
+		hash = (hash ^ (uint8_t)text[text_len]) * 16777619u;
+		glyphs_len += (text[text_len] != ' ');
+	}
+	hash = (hash ^ (size | (ui_scale << 8))) * 16777619u;
+
+	uint32_t mask = UI_TEXT_CACHE_LEN - 1;
+	uint32_t index = hash & mask;
+	while (text_runs[index].used) {
+		ui_text_run_t *run = &text_runs[index];
+		if (
+			run->hash == hash && run->size == size && run->scale == ui_scale &&
+			strcmp(&text_chars[run->text_start], text) == 0
+		) {
+			return run;
+		}
+		index = (index + 1) & mask;
+	}
+
+	// Not cached yet. Very long strings are not worth caching.
+	if (glyphs_len > UI_TEXT_RUN_GLYPHS_MAX || text_len >= UI_TEXT_RUN_GLYPHS_MAX * 2) {
+		return NULL;
+	}
+
+	if (
+		text_runs_len >= UI_TEXT_CACHE_LEN / 2 ||
+		text_tris_len + glyphs_len * 2 > UI_TEXT_CACHE_TRIS ||
+		text_chars_len + text_len + 1 > UI_TEXT_CACHE_CHARS
+	) {
+		ui_text_cache_clear();
+		index = hash & mask;
+	}
+
+	ui_text_run_t *run = &text_runs[index];
+	*run = (ui_text_run_t){
+		.hash = hash,
+		.text_start = text_chars_len,
+		.tris_start = text_tris_len,
+		.tris_len = glyphs_len * 2,
+		.width = ui_text_width(text, size),
+		.size = size,
+		.scale = ui_scale,
+		.used = true
+	};
+	memcpy(&text_chars[text_chars_len], text, text_len + 1);
+	text_chars_len += text_len + 1;
+	text_runs_len++;
+
+	char_set_t *cs = &char_set[size];
+	tris_t *tris = &text_tris[text_tris_len];
+	int x = 0;
+	for (uint32_t i = 0; i < text_len; i++) {
+		if (text[i] == ' ') {
+			x += 8 * ui_scale;
+			continue;
+		}
+		glyph_t *glyph = &cs->glyphs[char_to_glyph_index(text[i])];
+		vec2i_t uv = glyph->offset;
+		vec2i_t uv_size = vec2i(glyph->width, cs->height);
+		vec2i_t s = ui_scaled(uv_size);
+		*(tris++) = (tris_t){
+			.vertices = {
+				{.pos = {x, s.y, 0}, .uv = {uv.x, uv.y + uv_size.y}},
+				{.pos = {x + s.x, 0, 0}, .uv = {uv.x + uv_size.x, uv.y}},
+				{.pos = {x, 0, 0}, .uv = {uv.x, uv.y}},
+			}
+		};
+		*(tris++) = (tris_t){
+			.vertices = {
+				{.pos = {x + s.x, s.y, 0}, .uv = {uv.x + uv_size.x, uv.y + uv_size.y}},
+				{.pos = {x + s.x, 0, 0}, .uv = {uv.x + uv_size.x, uv.y}},
+				{.pos = {x, s.y, 0}, .uv = {uv.x, uv.y + uv_size.y}},
+			}
+		};
+		x += s.x;
+	}
+	text_tris_len += run->tris_len;
+	return run;
+}
+
 void ui_draw_text(const char *text, vec2i_t pos, ui_text_size_t size, rgba_t color) {
 	char_set_t *cs = &char_set[size];
 
+	ui_text_run_t *run = ui_text_run(text, size);
+	if (run) {
+		render_push_2d_tris(&text_tris[run->tris_start], run->tris_len, pos, color, cs->texture);
+		return;
+	}
+
 	for (int i = 0; text[i] != 0; i++) {
 		if (text[i] != ' ') {
 			glyph_t *glyph = &cs->glyphs[char_to_glyph_index(text[i])];
@@ -208,6 +332,12 @@ void ui_draw_icon(ui_icon_type_t icon, vec2i_t pos, rgba_t color) {
 }
 
 void ui_draw_text_centered(const char *text, vec2i_t pos, ui_text_size_t size, rgba_t color) {
+	ui_text_run_t *run = ui_text_run(text, size);
+	if (run) {
+		pos.x -= (run->width * ui_scale) >> 1;
+		render_push_2d_tris(&text_tris[run->tris_start], run->tris_len, pos, color, char_set[size].texture);
+		return;
+	}
 	pos.x -= (ui_text_width(text, size) * ui_scale) >> 1;
 	ui_draw_text(text, pos, size, color);
 }
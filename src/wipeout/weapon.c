@@ -1,6 +1,7 @@
 #include "../mem.h"
 #include "../utils.h"
 #include "../system.h"
+#include "../profile.h"
 
 #include "track.h"
 #include "ship.h"
@@ -10,6 +11,7 @@
 #include "image.h"
 #include "particle.h"
 #include "camera.h"
+#include "snapshot.h"
 
 extern int32_t ctrlNeedTargetIcon;
 extern int ctrlnearShip;
@@ -111,6 +113,41 @@ void weapons_init(void) {
 	weapons_active = 0;
 }
 
+uint32_t weapons_snapshot_size_max(void) {
+	return sizeof(int32_t) + sizeof(weapon_t) * WEAPONS_MAX;
+}
+
+uint32_t weapons_snapshot_save(uint8_t *bytes) {
+	int32_t count = weapons_active;
+	memcpy(bytes, &count, sizeof(count));
+	uint32_t p = sizeof(count);
+	for (int i = 0; i < weapons_active; i++) {
+		weapon_t w = weapons[i];
+		w.owner = SNAPSHOT_PTR_ENCODE(w.owner, g.ships);
+		w.target = SNAPSHOT_PTR_ENCODE(w.target, g.ships);
+		w.section = SNAPSHOT_PTR_ENCODE(w.section, g.track.sections);
+		memcpy(bytes + p, &w, sizeof(w));
+		p += sizeof(w);
+	}
+	return p;
+}
+
+uint32_t weapons_snapshot_restore(uint8_t *bytes) {
+	int32_t count;
+	memcpy(&count, bytes, sizeof(count));
+	uint32_t p = sizeof(count);
+	weapons_active = count;
+	for (int i = 0; i < weapons_active; i++) {
+		weapon_t *w = &weapons[i];
+		memcpy(w, bytes + p, sizeof(*w));
+		p += sizeof(*w);
+		w->owner = SNAPSHOT_PTR_DECODE(w->owner, g.ships);
+		w->target = SNAPSHOT_PTR_DECODE(w->target, g.ships);
+		w->section = SNAPSHOT_PTR_DECODE(w->section, g.track.sections);
+	}
+	return p;
+}
+
 weapon_t *weapon_init(ship_t *ship) {
 	if (weapons_active == WEAPONS_MAX) {
 		return NULL;
@@ -162,6 +199,7 @@ void weapons_fire_delayed(ship_t *ship, int weapon_type) {
 bool weapon_collides_with_track(weapon_t *self);
 
 void weapons_update(void) {
+	PROFILE_BEGIN("weapons_update");
 	for (int i = 0; i < weapons_active; i++) {
 		weapon_t *weapon = &weapons[i];
 		
@@ -189,7 +227,7 @@ void weapons_update(void) {
 				weapon->trail_spawn_timer += system_tick();
 				while (weapon->trail_spawn_timer > 0) {
 					vec3_t pos = vec3_sub(weapon->position, vec3_mulf(weapon->velocity, 30 * system_tick() * weapon->trail_spawn_timer));
-					vec3_t velocity = vec3_rand(128);
+					vec3_t velocity = vec3_rand(&g.rand_fx, 128);
 					particles_spawn(pos, weapon->trail_particle, velocity, 128);
 					weapon->trail_spawn_timer -= WEAPON_PARTICLE_SPAWN_RATE;
 				}
@@ -199,7 +237,7 @@ void weapons_update(void) {
 			weapon->section = track_nearest_section(weapon->position, vec3(1,1,1), weapon->section, NULL);
 			if (weapon_collides_with_track(weapon)) {
 				for (int p = 0; p < 32; p++) {
-					vec3_t velocity = vec3_rand(512);
+					vec3_t velocity = vec3_rand(&g.rand_fx, 512);
 					particles_spawn(weapon->position, weapon->track_hit_particle, velocity, 256);
 				}
 				sfx_play_at(SFX_EXPLOSION_2, weapon->position, vec3(0,0,0), 1);
@@ -213,6 +251,7 @@ void weapons_update(void) {
 			continue;
 		}
 	}
+	PROFILE_END("weapons_update");
 }
 
 void weapons_draw(void) {
@@ -277,7 +316,7 @@ ship_t *weapon_collides_with_ship(weapon_t *self) {
 		float distance = vec3_len(vec3_sub(ship->position, self->position));
 		if (distance < 512) {
 			for (int p = 0; p < 32; p++) {
-				vec3_t velocity = vec3_rand(512);
+				vec3_t velocity = vec3_rand(&g.rand_fx, 512);
 				velocity = vec3_add(velocity, vec3_mulf(ship->velocity, 0.25));
 				particles_spawn(self->position, self->ship_hit_particle, velocity, 256);
 			}
@@ -336,7 +375,7 @@ void weapon_update_mine_wait_for_release(weapon_t *self) {
 		self->update_func = weapon_update_mine;
 		self->model = weapon_assets.mine;
 		self->position = self->owner->position;
-		self->angle.y = rand_float(0, M_PI * 2);
+		self->angle.y = rand_float(&g.rand_fx, 0, M_PI * 2);
 
 		self->trail_particle = PARTICLE_TYPE_NONE;
 		self->track_hit_particle = PARTICLE_TYPE_NONE;
@@ -428,14 +467,14 @@ void weapon_update_missile(weapon_t *self) {
 		if (flags_not(ship->flags, SHIP_SHIELDED)) {
 			if (ship->pilot == g.pilot) {
 				ship->velocity = vec3_sub(ship->velocity, vec3_mulf(ship->velocity, 0.75));
-				ship->angular_velocity.z += rand_float(-0.1, 0.1);
-				ship->turn_rate_from_hit = rand_float(-0.1, 0.1);
+				ship->angular_velocity.z += rand_float(&g.rand_sim, -0.1, 0.1);
+				ship->turn_rate_from_hit = rand_float(&g.rand_sim, -0.1, 0.1);
 				camera_set_shake(&g.camera, CAMERA_SHAKE_LONG);
 			}
 			else {
 				ship->speed = ship->speed * 0.03125;
 				ship->angular_velocity.z += 10 * M_PI;
-				ship->turn_rate_from_hit = rand_float(-M_PI, M_PI);
+				ship->turn_rate_from_hit = rand_float(&g.rand_sim, -M_PI, M_PI);
 			}
 		}
 	}
@@ -476,14 +515,14 @@ void weapon_update_rocket(weapon_t *self) {
 		if (flags_not(ship->flags, SHIP_SHIELDED)) {
 			if (ship->pilot == g.pilot) {
 				ship->velocity = vec3_sub(ship->velocity, vec3_mulf(ship->velocity, 0.75));
-				ship->angular_velocity.z += rand_float(-0.1, 0.1);;
-				ship->turn_rate_from_hit = rand_float(-0.1, 0.1);;
+				ship->angular_velocity.z += rand_float(&g.rand_sim, -0.1, 0.1);;
+				ship->turn_rate_from_hit = rand_float(&g.rand_sim, -0.1, 0.1);;
 				camera_set_shake(&g.camera, CAMERA_SHAKE_LONG);
 			}
 			else {
 				ship->speed = ship->speed * 0.03125;
 				ship->angular_velocity.z += 10 * M_PI;
-				ship->turn_rate_from_hit = rand_float(-M_PI, M_PI);
+				ship->turn_rate_from_hit = rand_float(&g.rand_sim, -M_PI, M_PI);
 			}
 		}
 	}
@@ -617,7 +656,7 @@ void weapon_fire_turbo(ship_t *ship) {
 
 int weapon_get_random_type(int type_class) {
 	if (type_class == WEAPON_CLASS_ANY) {
-		int index = rand_int(0, 65);
+		int index = rand_int(&g.rand_sim, 0, 65);
 		if (index < 17) {
 			return WEAPON_TYPE_ROCKET;
 		}
@@ -638,7 +677,7 @@ int weapon_get_random_type(int type_class) {
 		}
 	}
 	else if (type_class == WEAPON_CLASS_PROJECTILE) { 
-		int index = rand_int(0, 60);
+		int index = rand_int(&g.rand_sim, 0, 60);
 		if (index < 27) {
 			return WEAPON_TYPE_ROCKET;
 		}
@@ -48,4 +48,9 @@ void weapons_update(void);
 void weapons_draw(void);
 int weapon_get_random_type(int type_class);
 
+// Snapshot support, see snapshot.h; save and restore return the bytes used
+uint32_t weapons_snapshot_size_max(void);
+uint32_t weapons_snapshot_save(uint8_t *bytes);
+uint32_t weapons_snapshot_restore(uint8_t *bytes);
+
 #endif